@@ -0,0 +1,38 @@
+#-------------------------------------------------
+#
+# Headless tool searching the semi-global block-matching
+# parameters against ground truth disparities
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+CONFIG   += console
+CONFIG   -= app_bundle qt
+
+TARGET = SGBMAutoTune
+TEMPLATE = app
+
+
+SOURCES += main.cpp\
+        ../common/autotune.cpp\
+        ../common/pfm.cpp\
+        ../common/sgbmparams.cpp\
+        ../common/sgmcosts.cpp\
+        ../common/sgmengine.cpp\
+        ../common/sgmkernels.cpp\
+        ../common/threadpool.cpp
+
+HEADERS  += ../common/autotune.h\
+        ../common/pfm.h\
+        ../common/sgbmparams.h\
+        ../common/sgmcosts.h\
+        ../common/sgmengine.h\
+        ../common/sgmkernels.h\
+        ../common/threadpool.h
+
+INCLUDEPATH += ../common
+
+LIBS += -L/usr/local/lib -lopencv_core -lopencv_imgcodecs -lopencv_imgproc -lopencv_calib3d -lopencv_ximgproc -lpthread
+
+QMAKE_CXXFLAGS += -std=c++11
@@ -0,0 +1,236 @@
+// SGBMAutoTune: searches the semi-global block-matching parameters giving the best
+// depth maps on pairs with a ground truth disparity, without a GUI
+//
+// usage:
+//   SGBMAutoTune (--middlebury DIR | --list FILE) --output results.csv [options]
+//
+// --middlebury DIR: every sub-directory of DIR holding im0.png, im1.png and
+//                   disp0GT.pfm (or disp0.pfm) is a sample, as in the Middlebury datasets
+// --list FILE:      one sample per line: the left image, the right image, the ground truth (PFM)
+//
+// options:
+//   --params FILE          the parameters not searched (default: the ones of the tuner)
+//   --space FILE           the parameters to search, as "name: [min, max, step]" entries
+//                          (engine and cost included: "cost: [0, 4, 1]" compares the costs
+//                          of the SGM engine, see SGBMParams::COST_*)
+//   --strategy S           grid, random or descent (coordinate descent, the default)
+//   --candidates N         maximum number of candidates for grid and random (default 200)
+//   --seed N               seed of the random search
+//   --runtime-weight W     descent objective: bad pixel rate + W * runtime in ms (default 0)
+//   --rounds N             maximum number of rounds of the descent (default 5)
+//   --threshold T          error (in pixels) above which a pixel is bad (default 2)
+//   --scale N              downscale the samples by N (the Middlebury images are large)
+//   --threads N            number of candidates evaluated at the same time (default: one per core)
+//   --best FILE            save the best parameters found in a parameter file
+//
+// all the candidates are written in the CSV file, with their bad pixel rate, their mean
+// runtime, and whether they are on the Pareto front of accuracy and speed
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "autotune.h"
+#include "pfm.h"
+#include "sgbmparams.h"
+#include "threadpool.h"
+
+static bool file_exists(const std::string &filename)
+{
+    return bool(std::ifstream(filename.c_str()));
+}
+
+// we load a sample, downscaled by the given factor (the disparities shrink as well)
+static bool load_sample(const std::string &name, const std::string &left, const std::string &right,
+                        const std::string &ground_truth, int scale, StereoSample &sample)
+{
+    sample.name = name;
+    sample.left = cv::imread(left, cv::IMREAD_GRAYSCALE);
+    sample.right = cv::imread(right, cv::IMREAD_GRAYSCALE);
+    sample.ground_truth = read_pfm(ground_truth);
+    if (sample.left.empty() || sample.right.empty() || sample.ground_truth.empty()) {
+        std::cerr << name << ": can't read the images or the ground truth, skipped" << std::endl;
+        return false;
+    }
+
+    if (scale > 1) {
+        cv::Size size(sample.left.cols / scale, sample.left.rows / scale);
+        cv::resize(sample.left, sample.left, size, 0, 0, cv::INTER_AREA);
+        cv::resize(sample.right, sample.right, size, 0, 0, cv::INTER_AREA);
+        cv::resize(sample.ground_truth, sample.ground_truth, size, 0, 0, cv::INTER_NEAREST);
+        sample.ground_truth /= scale;
+    }
+    return true;
+}
+
+static void load_middlebury(const std::string &dir, int scale, std::vector<StereoSample> &samples)
+{
+    std::vector<cv::String> left_files;
+    cv::glob(dir + "/*/im0.png", left_files, false);
+
+    for (size_t i = 0; i < left_files.size(); i++) {
+        std::string folder = std::string(left_files[i]).substr(0, left_files[i].size() - std::string("im0.png").size());
+        std::string ground_truth = folder + "disp0GT.pfm";
+        if (!file_exists(ground_truth))
+            ground_truth = folder + "disp0.pfm";
+
+        StereoSample sample;
+        if (load_sample(folder, left_files[i], folder + "im1.png", ground_truth, scale, sample))
+            samples.push_back(sample);
+    }
+}
+
+static bool load_list(const std::string &filename, int scale, std::vector<StereoSample> &samples)
+{
+    std::ifstream file(filename.c_str());
+    if (!file)
+        return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string left, right, ground_truth;
+        StereoSample sample;
+        if (fields >> left >> right >> ground_truth && load_sample(left, left, right, ground_truth, scale, sample))
+            samples.push_back(sample);
+    }
+    return true;
+}
+
+static void usage()
+{
+    std::cerr << "usage: SGBMAutoTune (--middlebury DIR | --list FILE) --output FILE [--params FILE] [--space FILE]"
+              << " [--strategy grid|random|descent] [--candidates N] [--seed N] [--runtime-weight W] [--rounds N]"
+              << " [--threshold T] [--scale N] [--threads N] [--best FILE]" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string middlebury_dir, list_file, output_file, params_file, space_file, best_file;
+    std::string strategy = "descent";
+    int candidates = 200, rounds = 5, scale = 1, threads = 0;
+    unsigned seed = 0;
+    double runtime_weight = 0, threshold = 2.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--middlebury" && has_value)
+            middlebury_dir = argv[++i];
+        else if (arg == "--list" && has_value)
+            list_file = argv[++i];
+        else if (arg == "--output" && has_value)
+            output_file = argv[++i];
+        else if (arg == "--params" && has_value)
+            params_file = argv[++i];
+        else if (arg == "--space" && has_value)
+            space_file = argv[++i];
+        else if (arg == "--best" && has_value)
+            best_file = argv[++i];
+        else if (arg == "--strategy" && has_value)
+            strategy = argv[++i];
+        else if (arg == "--candidates" && has_value)
+            candidates = std::atoi(argv[++i]);
+        else if (arg == "--rounds" && has_value)
+            rounds = std::atoi(argv[++i]);
+        else if (arg == "--scale" && has_value)
+            scale = std::atoi(argv[++i]);
+        else if (arg == "--threads" && has_value)
+            threads = std::atoi(argv[++i]);
+        else if (arg == "--seed" && has_value)
+            seed = unsigned(std::strtoul(argv[++i], 0, 10));
+        else if (arg == "--runtime-weight" && has_value)
+            runtime_weight = std::atof(argv[++i]);
+        else if (arg == "--threshold" && has_value)
+            threshold = std::atof(argv[++i]);
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    if (output_file.empty() || (middlebury_dir.empty() && list_file.empty()) ||
+        (strategy != "grid" && strategy != "random" && strategy != "descent")) {
+        usage();
+        return 2;
+    }
+
+    SGBMParams base;
+    if (!params_file.empty() && !SGBMParams::load(params_file, base)) {
+        std::cerr << "can't read the parameter file " << params_file << std::endl;
+        return 1;
+    }
+
+    SearchSpace space = SearchSpace::default_space();
+    if (!space_file.empty() && !SearchSpace::load(space_file, space)) {
+        std::cerr << "can't read the search space " << space_file << std::endl;
+        return 1;
+    }
+
+    std::vector<StereoSample> samples;
+    if (!middlebury_dir.empty())
+        load_middlebury(middlebury_dir, scale, samples);
+    if (!list_file.empty() && !load_list(list_file, scale, samples)) {
+        std::cerr << "can't read the list of samples " << list_file << std::endl;
+        return 1;
+    }
+    if (samples.empty()) {
+        std::cerr << "no sample to evaluate the parameters on" << std::endl;
+        return 1;
+    }
+
+    // the candidates are evaluated in parallel, so each matcher runs on a single thread
+    ThreadPool pool(threads);
+    if (pool.size() > 1)
+        cv::setNumThreads(1);
+
+    std::cout << "evaluating on " << samples.size() << " samples with " << pool.size() << " threads" << std::endl;
+
+    AutoTuner tuner(samples, pool, threshold);
+    std::vector<Candidate> results;
+    if (strategy == "grid")
+        results = tuner.grid_search(base, space, candidates);
+    else if (strategy == "random")
+        results = tuner.random_search(base, space, candidates, seed);
+    else
+        results = tuner.coordinate_descent(base, space, runtime_weight, rounds);
+
+    AutoTuner::mark_pareto_front(results);
+    if (!AutoTuner::write_csv(output_file, results)) {
+        std::cerr << "can't write " << output_file << std::endl;
+        return 1;
+    }
+
+    // the best candidate, for the same objective as the descent
+    const Candidate *best = 0;
+    double best_objective = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < results.size(); i++) {
+        double objective = results[i].bad_pixel_rate + runtime_weight * results[i].runtime_ms;
+        if (results[i].valid && objective < best_objective) {
+            best = &results[i];
+            best_objective = objective;
+        }
+    }
+    if (!best) {
+        std::cerr << "no valid candidate" << std::endl;
+        return 1;
+    }
+
+    std::cout << results.size() << " candidates evaluated; best: "
+              << 100 * best->bad_pixel_rate << "% bad pixels, "
+              << best->runtime_ms << " ms per pair" << std::endl;
+
+    if (!best_file.empty() && !best->params.save(best_file)) {
+        std::cerr << "can't write " << best_file << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#-------------------------------------------------
+#
+# Headless tool computing the depth maps of a whole
+# stereo dataset with a parameter file saved by the tuner
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+CONFIG   += console
+CONFIG   -= app_bundle qt
+
+TARGET = SGBMBatch
+TEMPLATE = app
+
+
+SOURCES += main.cpp\
+        ../common/directories.cpp\
+        ../common/mappedfile.cpp\
+        ../common/pfm.cpp\
+        ../common/rawstereo.cpp\
+        ../common/sgbmparams.cpp\
+        ../common/sgmcosts.cpp\
+        ../common/sgmengine.cpp\
+        ../common/sgmkernels.cpp\
+        ../common/stereomatch.cpp\
+        ../common/threadpool.cpp
+
+HEADERS  += ../common/directories.h\
+        ../common/mappedfile.h\
+        ../common/pfm.h\
+        ../common/rawstereo.h\
+        ../common/sgbmparams.h\
+        ../common/sgmcosts.h\
+        ../common/sgmengine.h\
+        ../common/sgmkernels.h\
+        ../common/stereomatch.h\
+        ../common/threadpool.h
+
+INCLUDEPATH += ../common
+
+LIBS += -L/usr/local/lib -lopencv_core -lopencv_imgcodecs -lopencv_imgproc -lopencv_calib3d -lopencv_ximgproc -lpthread
+
+QMAKE_CXXFLAGS += -std=c++11
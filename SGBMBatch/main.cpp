@@ -0,0 +1,365 @@
+// SGBMBatch: computes the depth maps of a list of stereo pairs, without a GUI
+//
+// usage:
+//   SGBMBatch --params params.yml --list pairs.txt --output DIR [options]
+//   SGBMBatch --params params.yml --left-dir DIR --right-dir DIR --output DIR [options]
+//   SGBMBatch (--list pairs.txt | --left-dir DIR --right-dir DIR) --pack capture.stereo [--fps F]
+//
+// the parameter file is the one saved by the tuner ("save params" button)
+// pairs.txt holds one pair per line: the left image, then the right image
+// with --left-dir and --right-dir, the images with the same name in both directories are paired
+//
+// options:
+//   --threads N   number of pairs processed at the same time (default: one per core)
+//   --wls         post-process the disparities with the wls-filter
+//   --png         also write a normalized 8 bits picture of each depth map
+//
+// with --pack, the pairs are not matched: they are converted to gray and stored in a raw
+// stereo capture, that the tuner maps in memory instead of decoding (see rawstereo.h)
+// --fps gives the frame rate recorded in the capture
+//
+// for each pair, the disparity (in pixels, infinity where unknown) is written in
+// DIR/<name>.pfm, and the timings of all the pairs in DIR/timing.csv (DIR is created if needed)
+// the name is the path of the left image relative to the directory holding all the left
+// images, without its extension, and with the '/' replaced by '_' (so Scene/im0.png gives
+// Scene_im0.pfm); two pairs giving the same name are an error
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "directories.h"
+#include "pfm.h"
+#include "rawstereo.h"
+#include "sgbmparams.h"
+#include "stereomatch.h"
+#include "threadpool.h"
+
+struct Pair {
+    std::string left;
+    std::string right;
+    std::string name;  // of the output files, unique among the pairs
+};
+
+// what happened to one pair
+struct Result {
+    bool ok;
+    std::string error;
+    int width;
+    int height;
+    double load_ms;
+    double match_ms;
+    double write_ms;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_ms(const Clock::time_point &start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static std::string file_name(const std::string &path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static std::string directory(const std::string &path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+static std::string without_extension(const std::string &path)
+{
+    size_t dot = path.find_last_of('.');
+    return dot == std::string::npos || dot < directory(path).size() ? path : path.substr(0, dot);
+}
+
+// we name the outputs after the left images, relative to the directory holding all of them,
+// so that the pairs of several directories with the same file names do not overwrite each other
+// (false if two pairs still have the same name)
+static bool name_outputs(std::vector<Pair> &pairs)
+{
+    if (pairs.empty())
+        return true;
+
+    std::string root = directory(pairs[0].left);
+    for (size_t i = 1; i < pairs.size(); i++)
+        while (pairs[i].left.compare(0, root.size(), root) != 0)
+            root = directory(root.substr(0, root.size() - 1));
+
+    std::map<std::string, size_t> names;
+    for (size_t i = 0; i < pairs.size(); i++) {
+        std::string name = without_extension(pairs[i].left.substr(root.size()));
+        for (size_t c = 0; c < name.size(); c++)
+            if (name[c] == '/' || name[c] == '\\')
+                name[c] = '_';
+        pairs[i].name = name;
+
+        std::map<std::string, size_t>::iterator other = names.find(name);
+        if (other != names.end()) {
+            std::cerr << pairs[other->second].left << " and " << pairs[i].left
+                      << " would both be written in " << name << ".pfm" << std::endl;
+            return false;
+        }
+        names[name] = i;
+    }
+    return true;
+}
+
+// the error messages of OpenCV span several lines, and may contain commas
+static std::string csv_field(std::string text)
+{
+    for (size_t i = 0; i < text.size(); i++)
+        if (text[i] == ',' || text[i] == '\n' || text[i] == '\r')
+            text[i] = ' ';
+    return text;
+}
+
+static bool read_pair_list(const std::string &filename, std::vector<Pair> &pairs)
+{
+    std::ifstream file(filename.c_str());
+    if (!file)
+        return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        Pair pair;
+        if (fields >> pair.left >> pair.right)
+            pairs.push_back(pair);
+    }
+    return true;
+}
+
+// we pair the images of both directories by name
+static void list_pairs(const std::string &left_dir, const std::string &right_dir, std::vector<Pair> &pairs)
+{
+    std::vector<cv::String> left_files;
+    cv::glob(left_dir, left_files, false);
+
+    for (size_t i = 0; i < left_files.size(); i++) {
+        Pair pair;
+        pair.left = left_files[i];
+        pair.right = right_dir + "/" + file_name(pair.left);
+        if (std::ifstream(pair.right.c_str()))
+            pairs.push_back(pair);
+        else
+            std::cerr << "no right image for " << pair.left << ", skipped" << std::endl;
+    }
+}
+
+static void usage()
+{
+    std::cerr << "usage: SGBMBatch --params FILE (--list FILE | --left-dir DIR --right-dir DIR) --output DIR"
+              << " [--threads N] [--wls] [--png]" << std::endl
+              << "       SGBMBatch (--list FILE | --left-dir DIR --right-dir DIR) --pack FILE [--fps F]" << std::endl;
+}
+
+// we store all the pairs in a raw stereo capture, in order (the pairs must have the same size)
+static int pack(const std::vector<Pair> &pairs, const std::string &filename, double fps)
+{
+    RawStereoWriter writer;
+    int packed = 0;
+    for (size_t i = 0; i < pairs.size(); i++) {
+        cv::Mat left = cv::imread(pairs[i].left, cv::IMREAD_GRAYSCALE);
+        cv::Mat right = cv::imread(pairs[i].right, cv::IMREAD_GRAYSCALE);
+        if (left.empty() || right.empty()) {
+            std::cerr << pairs[i].left << ": can't read the images, skipped" << std::endl;
+            continue;
+        }
+        if (packed == 0 && !writer.open(filename, left.size(), fps)) {
+            std::cerr << "can't write " << filename << std::endl;
+            return 1;
+        }
+        if (!writer.append(left, right)) {
+            std::cerr << pairs[i].left << ": the images should have the size of the first pair, skipped" << std::endl;
+            continue;
+        }
+        packed++;
+    }
+
+    if (packed > 0 && !writer.close()) {
+        std::cerr << "can't write " << filename << std::endl;
+        return 1;
+    }
+    std::cout << packed << "/" << pairs.size() << " pairs packed in " << filename << std::endl;
+    return packed == int(pairs.size()) ? 0 : 1;
+}
+
+static Result process(const Pair &pair, const SGBMParams &params, const std::string &output_dir,
+                      bool wls, bool png)
+{
+    Result result = { false, "", 0, 0, 0, 0, 0 };
+
+    Clock::time_point start = Clock::now();
+    cv::Mat left = cv::imread(pair.left, cv::IMREAD_GRAYSCALE);
+    cv::Mat right = cv::imread(pair.right, cv::IMREAD_GRAYSCALE);
+    result.load_ms = elapsed_ms(start);
+    if (left.empty() || right.empty()) {
+        result.error = "can't read the images";
+        return result;
+    }
+    if (left.size() != right.size()) {
+        result.error = "left and right images should be the same size";
+        return result;
+    }
+    result.width = left.cols;
+    result.height = left.rows;
+
+    start = Clock::now();
+    cv::Mat disparity;
+    try {
+        if (wls)
+            compute_filtered_disparity(params, left, right, disparity);
+        else
+            compute_disparity(params, left, right, disparity);
+    } catch (const cv::Exception &e) {
+        result.error = e.what();
+        return result;
+    }
+    result.match_ms = elapsed_ms(start);
+
+    start = Clock::now();
+    std::string output = output_dir + "/" + pair.name;
+    if (!write_pfm(output + ".pfm", disparity_to_pixels(disparity, params.min_disparity))) {
+        result.error = "can't write " + output + ".pfm";
+        return result;
+    }
+    if (png) {
+        cv::Mat picture;
+        cv::normalize(disparity, picture, 0, 255, cv::NORM_MINMAX, CV_8U);
+        cv::imwrite(output + ".png", picture);
+    }
+    result.write_ms = elapsed_ms(start);
+
+    result.ok = true;
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string params_file, list_file, left_dir, right_dir, output_dir, pack_file;
+    double fps = 0;
+    int threads = 0;
+    bool wls = false, png = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--params" && has_value)
+            params_file = argv[++i];
+        else if (arg == "--list" && has_value)
+            list_file = argv[++i];
+        else if (arg == "--left-dir" && has_value)
+            left_dir = argv[++i];
+        else if (arg == "--right-dir" && has_value)
+            right_dir = argv[++i];
+        else if (arg == "--output" && has_value)
+            output_dir = argv[++i];
+        else if (arg == "--threads" && has_value)
+            threads = std::atoi(argv[++i]);
+        else if (arg == "--pack" && has_value)
+            pack_file = argv[++i];
+        else if (arg == "--fps" && has_value)
+            fps = std::atof(argv[++i]);
+        else if (arg == "--wls")
+            wls = true;
+        else if (arg == "--png")
+            png = true;
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    bool packing = !pack_file.empty();
+    if ((!packing && (params_file.empty() || output_dir.empty())) ||
+            (list_file.empty() && (left_dir.empty() || right_dir.empty()))) {
+        usage();
+        return 2;
+    }
+
+    std::vector<Pair> pairs;
+    if (!list_file.empty()) {
+        if (!read_pair_list(list_file, pairs)) {
+            std::cerr << "can't read the list of pairs " << list_file << std::endl;
+            return 1;
+        }
+    } else {
+        list_pairs(left_dir, right_dir, pairs);
+    }
+
+    if (packing)
+        return pack(pairs, pack_file, fps);
+
+    SGBMParams params;
+    if (!SGBMParams::load(params_file, params)) {
+        std::cerr << "can't read the parameter file " << params_file << std::endl;
+        return 1;
+    }
+
+    // we check the outputs before matching anything
+    if (!name_outputs(pairs))
+        return 1;
+    if (!make_directories(output_dir)) {
+        std::cerr << "can't create the output directory " << output_dir << std::endl;
+        return 1;
+    }
+
+    // the pairs are processed in parallel, so each matcher runs on a single thread
+    ThreadPool pool(threads);
+    if (pool.size() > 1)
+        cv::setNumThreads(1);
+
+    std::vector<Result> results(pairs.size());
+    Clock::time_point start = Clock::now();
+    pool.parallel_for(int(pairs.size()), [&](int i) {
+        results[i] = process(pairs[i], params, output_dir, wls, png);
+        if (!results[i].ok)
+            std::cerr << pairs[i].left << ": " << results[i].error << std::endl;
+    });
+    double total_ms = elapsed_ms(start);
+
+    // the timings of each pair
+    std::string timing_file = output_dir + "/timing.csv";
+    std::ofstream timing(timing_file.c_str());
+    timing << "left,right,width,height,load_ms,match_ms,write_ms,status" << std::endl;
+    int failures = 0;
+    double match_ms = 0;
+    for (size_t i = 0; i < pairs.size(); i++) {
+        const Result &result = results[i];
+        timing << csv_field(pairs[i].left) << "," << csv_field(pairs[i].right) << ","
+               << result.width << "," << result.height << ","
+               << result.load_ms << "," << result.match_ms << "," << result.write_ms << ","
+               << (result.ok ? "ok" : csv_field(result.error)) << std::endl;
+        if (result.ok)
+            match_ms += result.match_ms;
+        else
+            failures++;
+    }
+
+    timing.close();
+    bool timing_written = bool(timing);
+    if (!timing_written)
+        std::cerr << "can't write " << timing_file << std::endl;
+
+    std::cout << pairs.size() - failures << "/" << pairs.size() << " pairs processed in "
+              << total_ms / 1000 << " s on " << pool.size() << " threads";
+    if (pairs.size() > size_t(failures))
+        std::cout << " (" << match_ms / (pairs.size() - failures) << " ms per match)";
+    std::cout << std::endl;
+
+    return failures == 0 && timing_written ? 0 : 1;
+}
@@ -13,15 +13,64 @@ TEMPLATE = app
 
 
 SOURCES += main.cpp\
-        mainwindow.cpp
+        mainwindow.cpp\
+        comparisondialog.cpp\
+        comparisonworker.cpp\
+        depthmapworker.cpp\
+        computescheduler.cpp\
+        streampipeline.cpp\
+        ../common/bufferpool.cpp\
+        ../common/diskcache.cpp\
+        ../common/disparitycache.cpp\
+        ../common/disparityview.cpp\
+        ../common/imageloader.cpp\
+        ../common/directories.cpp\
+        ../common/mappedfile.cpp\
+        ../common/previewimage.cpp\
+        ../common/rawstereo.cpp\
+        ../common/sgbmparams.cpp\
+        ../common/sgmcosts.cpp\
+        ../common/sgmengine.cpp\
+        ../common/sgmkernels.cpp\
+        ../common/stagetimer.cpp\
+        ../common/stereomatch.cpp\
+        ../common/stereosource.cpp\
+        ../common/threadpool.cpp\
+        ../common/tiledmatcher.cpp
 
-HEADERS  += mainwindow.h
+HEADERS  += mainwindow.h\
+        comparisondialog.h\
+        comparisonworker.h\
+        depthmapworker.h\
+        computescheduler.h\
+        streampipeline.h\
+        ../common/boundedqueue.h\
+        ../common/bufferpool.h\
+        ../common/diskcache.h\
+        ../common/disparitycache.h\
+        ../common/disparityview.h\
+        ../common/imageloader.h\
+        ../common/directories.h\
+        ../common/mappedfile.h\
+        ../common/previewimage.h\
+        ../common/rawstereo.h\
+        ../common/sgbmparams.h\
+        ../common/sgmcosts.h\
+        ../common/sgmengine.h\
+        ../common/sgmkernels.h\
+        ../common/stagetimer.h\
+        ../common/stereomatch.h\
+        ../common/stereosource.h\
+        ../common/threadpool.h\
+        ../common/tiledmatcher.h
 
 FORMS    += mainwindow.ui
 
 INCLUDEPATH += /usr/local/include/opencv \
 INCLUDEPATH += /usr/local/include/opencv2 \
 
-LIBS += -L/usr/local/lib -lopencv_core -lopencv_imgcodecs -lopencv_highgui -lopencv_imgproc -lopencv_calib3d -lopencv_ximgproc
+INCLUDEPATH += ../common
+
+LIBS += -L/usr/local/lib -lopencv_core -lopencv_imgcodecs -lopencv_highgui -lopencv_imgproc -lopencv_calib3d -lopencv_ximgproc -lopencv_videoio
 
 QMAKE_CXXFLAGS += -std=c++11 -DHAVE_CONFIG_H -fpermissive
@@ -0,0 +1,231 @@
+#include "comparisondialog.h"
+
+#include <QHBoxLayout>
+#include <QPixmap>
+#include <QStringList>
+#include <QVBoxLayout>
+
+#include "sgmcosts.h"
+
+// the size of the map of a cell
+static const QSize cell_image_size(320, 240);
+
+// the cells are laid out on rows of 4
+static const int grid_columns = 4;
+
+ComparisonDialog::ComparisonDialog(QWidget *parent) :
+    QDialog(parent),
+    colormap(false),
+    batch(0),
+    pending_cells(0)
+{
+    setWindowTitle("Compare parameters");
+
+    QPushButton *clear_button = new QPushButton("Clear", this);
+    filtered_check_box = new QCheckBox("wls filter", this);
+    status_label = new QLabel("add the parameters of the sliders with the compare button of the main window", this);
+    connect(clear_button, SIGNAL(clicked()), this, SLOT(clear_cells()));
+    connect(filtered_check_box, SIGNAL(toggled(bool)), this, SLOT(compute()));
+
+    QHBoxLayout *controls = new QHBoxLayout;
+    controls->addWidget(filtered_check_box);
+    controls->addWidget(clear_button);
+    controls->addWidget(status_label, 1);
+
+    grid = new QGridLayout;
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(controls);
+    layout->addLayout(grid);
+    layout->addStretch();
+
+    worker = new ComparisonWorker(this);
+    connect(worker, SIGNAL(cell_ready(int,int,QImage,double,double)),
+            this, SLOT(display_cell(int,int,QImage,double,double)), Qt::QueuedConnection);
+    connect(worker, SIGNAL(cell_failed(int,int,QString)),
+            this, SLOT(display_cell_error(int,int,QString)), Qt::QueuedConnection);
+    worker->start();
+}
+
+ComparisonDialog::~ComparisonDialog()
+{
+    worker->stop();
+}
+
+void ComparisonDialog::set_images(const cv::Mat &left, const cv::Mat &right)
+{
+    left_image = left;
+    right_image = right;
+    compute();
+}
+
+bool ComparisonDialog::add_cell(const SGBMParams &params)
+{
+    if (int(cells.size()) >= MAX_CELLS)
+        return false;
+
+    Cell cell;
+    cell.params = params;
+    cell.widget = new QWidget(this);
+    cell.image_label = new QLabel("waiting...", cell.widget);
+    cell.image_label->setAlignment(Qt::AlignCenter);
+    cell.image_label->setMinimumSize(cell_image_size / 2);
+    cell.caption_label = new QLabel(cell.widget);
+    cell.caption_label->setWordWrap(true);
+    cell.use_button = new QPushButton("Use", cell.widget);
+    cell.use_button->setToolTip("set the sliders of the main window to these parameters");
+    cell.remove_button = new QPushButton("Remove", cell.widget);
+    connect(cell.use_button, SIGNAL(clicked()), this, SLOT(use_cell()));
+    connect(cell.remove_button, SIGNAL(clicked()), this, SLOT(remove_cell()));
+
+    QHBoxLayout *buttons = new QHBoxLayout;
+    buttons->addWidget(cell.use_button);
+    buttons->addWidget(cell.remove_button);
+    QVBoxLayout *layout = new QVBoxLayout(cell.widget);
+    layout->addWidget(cell.image_label);
+    layout->addWidget(cell.caption_label);
+    layout->addLayout(buttons);
+
+    cells.push_back(cell);
+    layout_cells();
+    compute();
+    return true;
+}
+
+void ComparisonDialog::set_colormap(bool enabled)
+{
+    if (colormap == enabled)
+        return;
+    colormap = enabled;
+    compute();
+}
+
+// all the cells are computed again, in a new batch (the maps of the previous one are ignored)
+void ComparisonDialog::compute()
+{
+    if (cells.empty() || left_image.empty() || right_image.empty())
+        return;
+
+    std::vector<SGBMParams> params;
+    for (size_t i = 0; i < cells.size(); i++) {
+        params.push_back(cells[i].params);
+        cells[i].caption_label->setText(differences(cells[i].params, cells[0].params));
+    }
+    batch = worker->request(left_image, right_image, params, filtered_check_box->isChecked(),
+                            cell_image_size, colormap);
+    pending_cells = int(cells.size());
+    status_label->setText(QString("computing %1 maps...").arg(pending_cells));
+}
+
+void ComparisonDialog::display_cell(int batch, int index, const QImage &image, double runtime_ms, double density)
+{
+    if (batch != this->batch || index >= int(cells.size()))
+        return;
+
+    Cell &cell = cells[index];
+    cell.image_label->setPixmap(QPixmap::fromImage(image));
+    cell.caption_label->setText(QString("<b>%1 ms, %2% dense</b><br>%3")
+                                .arg(runtime_ms, 0, 'f', 1)
+                                .arg(100 * density, 0, 'f', 1)
+                                .arg(differences(cell.params, cells[0].params)));
+    if (--pending_cells == 0)
+        status_label->setText(QString("%1 maps computed in parallel (the times include the contention between the cells)")
+                              .arg(cells.size()));
+}
+
+void ComparisonDialog::display_cell_error(int batch, int index, const QString &message)
+{
+    if (batch != this->batch || index >= int(cells.size()))
+        return;
+
+    cells[index].image_label->setText("OpenCV refused these parameters");
+    cells[index].image_label->setToolTip(message);
+    if (--pending_cells == 0)
+        status_label->clear();
+}
+
+void ComparisonDialog::use_cell()
+{
+    int index = sender_cell();
+    if (index >= 0)
+        emit params_selected(cells[index].params);
+}
+
+void ComparisonDialog::remove_cell()
+{
+    int index = sender_cell();
+    if (index < 0)
+        return;
+
+    // the widget may still be handling the click
+    cells[index].widget->deleteLater();
+    cells.erase(cells.begin() + index);
+    layout_cells();
+    compute();
+}
+
+void ComparisonDialog::clear_cells()
+{
+    for (size_t i = 0; i < cells.size(); i++)
+        cells[i].widget->deleteLater();
+    cells.clear();
+    batch = 0;
+    status_label->clear();
+}
+
+void ComparisonDialog::layout_cells()
+{
+    for (size_t i = 0; i < cells.size(); i++) {
+        grid->removeWidget(cells[i].widget);
+        grid->addWidget(cells[i].widget, int(i) / grid_columns, int(i) % grid_columns);
+    }
+}
+
+// the cell whose button sent the signal
+int ComparisonDialog::sender_cell()
+{
+    for (size_t i = 0; i < cells.size(); i++)
+        if (sender() == cells[i].use_button || sender() == cells[i].remove_button)
+            return int(i);
+    return -1;
+}
+
+// the parameters of a cell that differ from the ones of the first cell
+// (all the matching parameters for the first cell itself)
+QString ComparisonDialog::differences(const SGBMParams &params, const SGBMParams &reference)
+{
+    QStringList list;
+    bool first = &params == &reference;
+    if (first || params.min_disparity != reference.min_disparity)
+        list << QString("min disparity %1").arg(params.min_disparity);
+    if (first || params.num_disparities != reference.num_disparities)
+        list << QString("disparities %1").arg(params.num_disparities);
+    if (first || params.block_size != reference.block_size)
+        list << QString("block %1").arg(params.block_size);
+    if (first || params.P1 != reference.P1)
+        list << QString("P1 %1").arg(params.P1);
+    if (first || params.P2 != reference.P2)
+        list << QString("P2 %1").arg(params.P2);
+    if (first || params.mode != reference.mode)
+        list << QString("mode %1").arg(params.mode);
+    if (first || params.uniqueness_ratio != reference.uniqueness_ratio)
+        list << QString("uniqueness %1").arg(params.uniqueness_ratio);
+    if (first || params.speckle_window_size != reference.speckle_window_size)
+        list << QString("speckle window %1").arg(params.speckle_window_size);
+    if (first || params.speckle_range != reference.speckle_range)
+        list << QString("speckle range %1").arg(params.speckle_range);
+    if (first || params.disp12_max_diff != reference.disp12_max_diff)
+        list << QString("disp12 %1").arg(params.disp12_max_diff);
+    if (first || params.pre_filter_cap != reference.pre_filter_cap)
+        list << QString("pre-filter cap %1").arg(params.pre_filter_cap);
+    if (first || params.engine != reference.engine)
+        list << (params.engine == SGBMParams::ENGINE_SGM ? "SGM engine" : "OpenCV");
+    if (params.engine == SGBMParams::ENGINE_SGM && (first || params.cost != reference.cost))
+        list << QString("cost %1").arg(MatchingCost::name(params.cost));
+    if (params.wls_lambda != reference.wls_lambda)
+        list << QString("lambda %1").arg(params.wls_lambda);
+    if (params.wls_sigma != reference.wls_sigma)
+        list << QString("sigma %1").arg(params.wls_sigma);
+    if (list.isEmpty())
+        return "same parameters as the first cell";
+    return list.join(", ");
+}
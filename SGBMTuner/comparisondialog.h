@@ -0,0 +1,83 @@
+#ifndef COMPARISONDIALOG_H
+#define COMPARISONDIALOG_H
+
+#include "opencv2/core/core.hpp"
+
+#include <QDialog>
+#include <QCheckBox>
+#include <QGridLayout>
+#include <QImage>
+#include <QLabel>
+#include <QPushButton>
+
+#include <vector>
+
+#include "comparisonworker.h"
+#include "sgbmparams.h"
+
+// a grid comparing the maps computed with several sets of parameters on the same images
+//
+// each cell holds a snapshot of the parameters (added from the sliders of the main
+// window), its map, the time it took and the fraction of pixels with a disparity;
+// its caption lists the parameters that differ from the first cell
+// the cells are computed in parallel, again every time a cell is added or removed
+class ComparisonDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ComparisonDialog(QWidget *parent = 0);
+    ~ComparisonDialog();
+
+    // more cells would be too small to be compared anyway
+    enum { MAX_CELLS = 8 };
+
+    // the images of all the cells (the maps are computed again)
+    void set_images(const cv::Mat &left, const cv::Mat &right);
+
+    // we add a cell with these parameters (false if the grid is full)
+    bool add_cell(const SGBMParams &params);
+
+    void set_colormap(bool enabled);
+
+signals:
+    // the "use" button of a cell: the main window takes these parameters back
+    void params_selected(const SGBMParams &params);
+
+private slots:
+    void compute();
+    void display_cell(int batch, int index, const QImage &image, double runtime_ms, double density);
+    void display_cell_error(int batch, int index, const QString &message);
+    void use_cell();
+    void remove_cell();
+    void clear_cells();
+
+private:
+    struct Cell {
+        SGBMParams params;
+        QWidget *widget;
+        QLabel *image_label;
+        QLabel *caption_label;
+        QPushButton *use_button;
+        QPushButton *remove_button;
+    };
+
+    std::vector<Cell> cells;
+    QGridLayout *grid;
+    QCheckBox *filtered_check_box;
+    QLabel *status_label;
+
+    cv::Mat left_image;
+    cv::Mat right_image;
+    bool colormap;
+
+    ComparisonWorker *worker;
+    int batch;            // the batch whose maps are displayed
+    int pending_cells;    // the cells of that batch not computed yet
+
+    void layout_cells();
+    int sender_cell();
+    static QString differences(const SGBMParams &params, const SGBMParams &reference);
+};
+
+#endif // COMPARISONDIALOG_H
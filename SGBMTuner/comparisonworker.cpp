@@ -0,0 +1,96 @@
+#include "comparisonworker.h"
+
+#include <QMutexLocker>
+
+#include <chrono>
+
+#include "disparityview.h"
+#include "stereomatch.h"
+
+ComparisonWorker::ComparisonWorker(QObject *parent) :
+    QThread(parent),
+    has_pending_batch(false),
+    stopping(false),
+    batch_count(0)
+{
+}
+
+ComparisonWorker::~ComparisonWorker()
+{
+    stop();
+}
+
+int ComparisonWorker::request(const cv::Mat &left, const cv::Mat &right, const std::vector<SGBMParams> &params,
+                              bool filtered, const QSize &display_size, bool colormap)
+{
+    QMutexLocker locker(&mutex);
+    pending_batch.number = ++batch_count;
+    pending_batch.left_image = left;
+    pending_batch.right_image = right;
+    pending_batch.params = params;
+    pending_batch.filtered = filtered;
+    pending_batch.display_size = display_size;
+    pending_batch.colormap = colormap;
+    has_pending_batch = true;
+    condition.wakeOne();
+    return batch_count;
+}
+
+void ComparisonWorker::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        condition.wakeOne();
+    }
+    wait();
+}
+
+void ComparisonWorker::run()
+{
+    forever {
+        Batch batch;
+        {
+            QMutexLocker locker(&mutex);
+            while (!has_pending_batch && !stopping)
+                condition.wait(&mutex);
+            if (stopping)
+                return;
+
+            batch = pending_batch;
+            has_pending_batch = false;
+            pending_batch.left_image.release();
+            pending_batch.right_image.release();
+        }
+
+        // one cell per task: the cells share the images, each one has its own matcher
+        pool.parallel_for(int(batch.params.size()), [&](int index) {
+            compute_cell(batch, index);
+        });
+    }
+}
+
+void ComparisonWorker::compute_cell(const Batch &batch, int index)
+{
+    const SGBMParams &params = batch.params[index];
+    cv::Mat disparity;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try {
+        if (batch.filtered)
+            compute_filtered_disparity(params, batch.left_image, batch.right_image, disparity);
+        else
+            compute_disparity(params, batch.left_image, batch.right_image, disparity);
+    } catch (const cv::Exception &e) {
+        emit cell_failed(batch.number, index, QString::fromStdString(e.what()));
+        return;
+    }
+    double runtime_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // the matchers mark the pixels without a disparity with min_disparity - 1
+    double density = double(cv::countNonZero(disparity >= params.min_disparity * 16)) / disparity.total();
+
+    DisparityView view;
+    view.set_colormap(batch.colormap);
+    QSize size = batch.display_size.boundedTo(QSize(disparity.cols, disparity.rows));
+    emit cell_ready(batch.number, index, view.render(disparity, size), runtime_ms, density);
+}
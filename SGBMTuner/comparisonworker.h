@@ -0,0 +1,78 @@
+#ifndef COMPARISONWORKER_H
+#define COMPARISONWORKER_H
+
+#include "opencv2/core/core.hpp"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+#include <vector>
+
+#include "sgbmparams.h"
+#include "threadpool.h"
+
+// the thread computing the maps of the comparison grid
+//
+// a batch holds the same pair of images and one set of parameters per cell; the cells
+// are computed in parallel on a thread pool (each one with its own matcher), and each
+// map is sent back as soon as it is ready
+// like the depth map worker, we only keep the latest batch: a batch requested while
+// another one is being computed replaces any batch still waiting
+class ComparisonWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit ComparisonWorker(QObject *parent = 0);
+    ~ComparisonWorker();
+
+    // we replace the pending batch with this one, and return its number
+    // (the images must not be modified after being handed to the worker)
+    int request(const cv::Mat &left, const cv::Mat &right, const std::vector<SGBMParams> &params,
+                bool filtered, const QSize &display_size, bool colormap);
+
+    // we ask the thread to terminate, and wait for it (after the batch being computed)
+    void stop();
+
+signals:
+    // emitted (from the threads of the pool) when the map of a cell has been computed
+    // runtime_ms is measured while the other cells are computed as well; density is the
+    // fraction of the pixels with a valid disparity
+    void cell_ready(int batch, int index, const QImage &image, double runtime_ms, double density);
+
+    // emitted (from the threads of the pool) when OpenCV refused the parameters of a cell
+    void cell_failed(int batch, int index, const QString &message);
+
+protected:
+    void run();
+
+private:
+    struct Batch {
+        int number;
+        cv::Mat left_image;
+        cv::Mat right_image;
+        std::vector<SGBMParams> params;
+        bool filtered;
+        QSize display_size;
+        bool colormap;
+    };
+
+    // shared with the GUI thread, protected by the mutex
+    QMutex mutex;
+    QWaitCondition condition;
+    bool has_pending_batch;
+    bool stopping;
+    int batch_count;
+    Batch pending_batch;
+
+    // only used from the worker thread
+    ThreadPool pool;
+
+    void compute_cell(const Batch &batch, int index);
+};
+
+#endif // COMPARISONWORKER_H
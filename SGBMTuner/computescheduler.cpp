@@ -0,0 +1,92 @@
+#include "computescheduler.h"
+
+#include <algorithm>
+
+ComputeScheduler::ComputeScheduler(DepthMapWorker *worker, QObject *parent) :
+    QObject(parent),
+    worker(worker),
+    preview_scale(2),
+    dragging(false),
+    preview_dispatched(false),
+    has_pending_request(false),
+    pending_type(DepthMapWorker::DEPTH_MAP),
+    last_type(DepthMapWorker::DEPTH_MAP),
+    received_count(0),
+    coalesced_count(0),
+    dispatched_count(0)
+{
+    // by default, we wait one frame at 60 fps before dispatching a request
+    debounce_timer.setSingleShot(true);
+    debounce_timer.setInterval(16);
+    connect(&debounce_timer, SIGNAL(timeout()), this, SLOT(dispatch_pending()));
+}
+
+void ComputeScheduler::set_debounce_interval(int msec)
+{
+    debounce_timer.setInterval(std::max(0, msec));
+}
+
+void ComputeScheduler::set_preview_scale(int scale)
+{
+    preview_scale = std::max(1, scale);
+}
+
+void ComputeScheduler::request(DepthMapWorker::JobType type, const SGBMParams &params)
+{
+    received_count++;
+    if (has_pending_request)
+        coalesced_count++;
+
+    has_pending_request = true;
+    pending_type = type;
+    pending_params = params;
+
+    // the timer is not restarted by the following requests, so that a long drag
+    // still produces one map per interval instead of none until the mouse stops
+    if (!debounce_timer.isActive())
+        debounce_timer.start();
+
+    emit statistics_changed();
+}
+
+void ComputeScheduler::begin_drag()
+{
+    dragging = true;
+    preview_dispatched = false;
+}
+
+// when the slider is released, we replace the preview with a full quality map right away
+void ComputeScheduler::end_drag()
+{
+    dragging = false;
+
+    if (has_pending_request) {
+        debounce_timer.stop();
+        dispatch_pending();
+    } else if (preview_dispatched) {
+        dispatch(last_type, last_params, 1);
+    }
+    preview_dispatched = false;
+}
+
+void ComputeScheduler::dispatch_pending()
+{
+    if (!has_pending_request)
+        return;
+
+    has_pending_request = false;
+    int scale = dragging ? preview_scale : 1;
+    if (scale > 1)
+        preview_dispatched = true;
+    dispatch(pending_type, pending_params, scale);
+}
+
+void ComputeScheduler::dispatch(DepthMapWorker::JobType type, const SGBMParams &params, int scale)
+{
+    last_type = type;
+    last_params = params;
+    dispatched_count++;
+    worker->request(type, params, scale);
+
+    emit statistics_changed();
+}
@@ -0,0 +1,74 @@
+#ifndef COMPUTESCHEDULER_H
+#define COMPUTESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+
+#include "depthmapworker.h"
+#include "sgbmparams.h"
+
+// sits between the slider callbacks and the worker thread
+//
+// a burst of parameter changes (dragging a slider emits one per pixel) is collapsed
+// into a single request per debounce interval: each new request replaces the one
+// waiting for the timer, and only the last one reaches the worker
+// while a slider is held down, the requests are sent as fast low-resolution previews,
+// and a full quality map is requested as soon as the slider is released
+class ComputeScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ComputeScheduler(DepthMapWorker *worker, QObject *parent = 0);
+
+    // the time (in ms) during which requests are collapsed together
+    void set_debounce_interval(int msec);
+
+    // the downscale factor used while dragging (1 disables the previews)
+    void set_preview_scale(int scale);
+
+    // we schedule a map computation with these parameters
+    void request(DepthMapWorker::JobType type, const SGBMParams &params);
+
+    // statistics: the requests received from the GUI, the ones replaced by a newer
+    // request before being dispatched, and the ones actually sent to the worker
+    int received_requests() const { return received_count; }
+    int coalesced_requests() const { return coalesced_count; }
+    int dispatched_requests() const { return dispatched_count; }
+
+public slots:
+    // connected to the sliderPressed() and sliderReleased() signals of the sliders
+    void begin_drag();
+    void end_drag();
+
+signals:
+    void statistics_changed();
+
+private slots:
+    void dispatch_pending();
+
+private:
+    DepthMapWorker *worker;
+    QTimer debounce_timer;
+
+    int preview_scale;
+    bool dragging;
+    bool preview_dispatched;  // a preview was shown during the current drag
+
+    // the latest request, waiting for the timer to fire
+    bool has_pending_request;
+    DepthMapWorker::JobType pending_type;
+    SGBMParams pending_params;
+
+    // the latest request sent to the worker, to refine a preview on release
+    DepthMapWorker::JobType last_type;
+    SGBMParams last_params;
+
+    int received_count;
+    int coalesced_count;
+    int dispatched_count;
+
+    void dispatch(DepthMapWorker::JobType type, const SGBMParams &params, int scale);
+};
+
+#endif // COMPUTESCHEDULER_H
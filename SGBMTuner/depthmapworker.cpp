@@ -0,0 +1,622 @@
+#include "depthmapworker.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+#include "stereomatch.h"
+
+DepthMapWorker::DepthMapWorker(QObject *parent) :
+    QThread(parent),
+    has_pending_job(false),
+    image_generation(0),
+    stopping(false),
+    progressive(true),
+    completed_job_count(0),
+    dropped_job_count(0),
+    last_job_allocations(0),
+    display_size(480, 360),
+    colormap(false),
+    max_threads(QThread::idealThreadCount()),
+    tiled(false),
+    tile_overlap(-1),
+    validate_tiles(false),
+    cost_volume_budget(size_t(SGMEngine::DEFAULT_COST_VOLUME_BUDGET_MB) << 20),
+    memory_limit(0),
+    stage_timer(0),
+    image_key_generation(-1)
+{
+    bmState = cv::StereoSGBM::create(-16, 128, 11);
+    rightState = cv::StereoSGBM::create(-16, 128, 11);
+}
+
+DepthMapWorker::~DepthMapWorker()
+{
+    stop();
+}
+
+void DepthMapWorker::set_images(const cv::Mat &left, const cv::Mat &right)
+{
+    QMutexLocker locker(&mutex);
+    left_image = left;
+    right_image = right;
+    image_generation++;
+}
+
+void DepthMapWorker::set_display_size(const QSize &size)
+{
+    QMutexLocker locker(&mutex);
+    display_size = size;
+}
+
+void DepthMapWorker::request(JobType type, const SGBMParams &params, int scale)
+{
+    QMutexLocker locker(&mutex);
+    if (has_pending_job)
+        dropped_job_count++;
+    pending_job.type = type;
+    pending_job.params = params;
+    pending_job.scale = std::max(1, scale);
+    pending_job.left_image = left_image;
+    pending_job.right_image = right_image;
+    pending_job.image_generation = image_generation;
+    pending_job.display_size = display_size;
+    pending_job.colormap = colormap;
+    pending_job.max_threads = max_threads;
+    pending_job.tiled = tiled;
+    pending_job.tile_overlap = tile_overlap;
+    pending_job.validate_tiles = validate_tiles;
+    pending_job.roi = roi;
+    pending_job.cost_volume_budget = cost_volume_budget;
+    pending_job.memory_limit = memory_limit;
+    has_pending_job = true;
+    condition.wakeOne();
+}
+
+void DepthMapWorker::set_progressive(bool enabled)
+{
+    QMutexLocker locker(&mutex);
+    progressive = enabled;
+}
+
+void DepthMapWorker::set_colormap(bool enabled)
+{
+    QMutexLocker locker(&mutex);
+    colormap = enabled;
+}
+
+void DepthMapWorker::set_max_threads(int count)
+{
+    QMutexLocker locker(&mutex);
+    max_threads = std::max(1, count);
+
+    // the matchers of OpenCV have their own thread pool, which we bound as well
+    cv::setNumThreads(max_threads);
+}
+
+void DepthMapWorker::set_tiled(bool enabled, int overlap, bool validate)
+{
+    QMutexLocker locker(&mutex);
+    tiled = enabled;
+    tile_overlap = overlap;
+    validate_tiles = validate;
+}
+
+void DepthMapWorker::set_roi(const cv::Rect &roi)
+{
+    QMutexLocker locker(&mutex);
+    this->roi = roi;
+}
+
+void DepthMapWorker::set_cost_volume_budget(size_t bytes)
+{
+    QMutexLocker locker(&mutex);
+    cost_volume_budget = bytes;
+}
+
+void DepthMapWorker::set_memory_limit(size_t bytes)
+{
+    QMutexLocker locker(&mutex);
+    memory_limit = bytes;
+}
+
+int DepthMapWorker::completed_jobs()
+{
+    QMutexLocker locker(&mutex);
+    return completed_job_count;
+}
+
+int DepthMapWorker::dropped_jobs()
+{
+    QMutexLocker locker(&mutex);
+    return dropped_job_count;
+}
+
+int DepthMapWorker::allocations_per_job()
+{
+    QMutexLocker locker(&mutex);
+    return last_job_allocations;
+}
+
+void DepthMapWorker::set_cache_budget(size_t bytes)
+{
+    cache.set_budget(bytes);
+}
+
+DisparityCache::Statistics DepthMapWorker::cache_statistics() const
+{
+    return cache.statistics();
+}
+
+bool DepthMapWorker::set_disk_cache(const std::string &directory, size_t budget_bytes)
+{
+    if (directory.empty()) {
+        disk_cache.close();
+        return true;
+    }
+    return disk_cache.open(directory, budget_bytes);
+}
+
+void DepthMapWorker::set_disk_cache_budget(size_t bytes)
+{
+    disk_cache.set_budget(bytes);
+}
+
+DiskCache::Statistics DepthMapWorker::disk_cache_statistics() const
+{
+    return disk_cache.statistics();
+}
+
+void DepthMapWorker::set_stage_timer(StageTimer *timer)
+{
+    stage_timer = timer;
+}
+
+void DepthMapWorker::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        condition.wakeOne();
+    }
+    wait();
+}
+
+void DepthMapWorker::run()
+{
+    forever {
+        Job job;
+        {
+            QMutexLocker locker(&mutex);
+            while (!has_pending_job && !stopping)
+                condition.wait(&mutex);
+            if (stopping)
+                return;
+
+            // we take the latest request; the ones it replaced are simply lost
+            job = pending_job;
+            has_pending_job = false;
+            pending_job.left_image.release();
+            pending_job.right_image.release();
+        }
+
+        // the buffers are kept as long as the images keep the same size (with a region of
+        // interest, only a part of them is used, see region_buffer())
+        if (job.left_image.size() != buffer_pool_image_size) {
+            buffer_pool.clear();
+            buffer_pool_image_size = job.left_image.size();
+            left_cache.clear();
+            right_cache.clear();
+        }
+        buffer_pool.begin_frame();
+        long view_allocations = disparity_view.allocations();
+
+        // the cached maps are identified by a hash of the images, computed once per pair
+        if (job.image_generation != image_key_generation) {
+            StageTimer::Scope scope(stage_timer, "hash");
+            image_key = DisparityCache::image_key(job.left_image, job.right_image);
+            image_key_generation = job.image_generation;
+        }
+
+        try {
+            // we go from the coarsest pyramid level to the requested one, displaying each
+            // intermediate map, unless the parameters changed in the meantime
+            // (a map already computed is displayed at once, without the previews)
+            int coarsest = has_cached_map(job) ? job.scale : coarsest_scale(job);
+            for (int scale = coarsest; scale >= job.scale; scale /= 2) {
+                if (scale < coarsest && is_cancelled())
+                    break;
+
+                QImage image = compute(job, scale);
+                if (!image.isNull())
+                    emit map_ready(image);
+            }
+
+            // the images sent to the GUI count as well
+            int allocations = buffer_pool.end_frame() + int(disparity_view.allocations() - view_allocations);
+            QMutexLocker locker(&mutex);
+            completed_job_count++;
+            last_job_allocations = allocations;
+        } catch (const cv::Exception &e) {
+            emit compute_failed(QString::fromStdString(e.what()));
+        }
+    }
+}
+
+// a newer request is waiting, so the current one should not be refined further
+bool DepthMapWorker::is_cancelled()
+{
+    QMutexLocker locker(&mutex);
+    return has_pending_job || stopping;
+}
+
+// the pyramid level where a progressive computation starts
+// we halve the resolution until the image is small enough to be matched in a few ms
+// (about 0.3 Mpixels), without going below 1/8 of the requested resolution
+int DepthMapWorker::coarsest_scale(const Job &job)
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (!progressive)
+            return job.scale;
+    }
+
+    const double max_pixels = 300000;
+    double pixels = double(job.left_image.cols) * job.left_image.rows / (job.scale * job.scale);
+    int scale = job.scale;
+    while (pixels > max_pixels && scale < 8 * job.scale) {
+        scale *= 2;
+        pixels /= 4;
+    }
+    return scale;
+}
+
+// whether the map at the requested resolution is in one of the caches (in validation mode,
+// the maps are always computed, so that they are validated)
+bool DepthMapWorker::has_cached_map(const Job &job)
+{
+    if (job.validate_tiles)
+        return false;
+    std::string key = cache_key(job, job.scale, job.params.scaled(job.scale));
+    cv::Mat cached;
+    return cache.find(key, cached) || disk_cache.contains(key);
+}
+
+// we compute the requested map at the given scale, and convert it to an image the GUI can display
+QImage DepthMapWorker::compute(const Job &job, int scale)
+{
+    if (job.left_image.empty() || job.right_image.empty())
+        return QImage();
+
+    // for a preview, we work on downscaled images, with parameters scaled accordingly
+    // all the intermediate images come from the buffer pool, one set per pyramid level
+    cv::Mat left = job.left_image, right = job.right_image;
+    cv::Size size(job.left_image.cols / scale, job.left_image.rows / scale);
+    if (scale > 1) {
+        StageTimer::Scope scope(stage_timer, "downscale");
+        left = buffer_pool.get("left", size, CV_8UC1);
+        right = buffer_pool.get("right", size, CV_8UC1);
+        cv::resize(job.left_image, left, size, 0, 0, cv::INTER_AREA);
+        cv::resize(job.right_image, right, size, 0, 0, cv::INTER_AREA);
+    }
+    SGBMParams params = job.params.scaled(scale);
+
+    // with a region of interest, we only match the region, with the margin the
+    // matcher needs around it
+    cv::Rect roi = scaled_roi(job, scale, size);
+    cv::Rect region = matching_region(job, roi, params, size);
+    if (region.size() != size) {
+        left = left(region);
+        right = right(region);
+    }
+
+    // a map already computed with these parameters is displayed straight away (except in
+    // validation mode, where it is computed again to be validated)
+    std::string key = cache_key(job, scale, params);
+    cv::Mat cached;
+    if (!job.validate_tiles && cache.find(key, cached))
+        return to_display_image(cached, job);
+
+    // the maps of the previous sessions are only stored at full resolution (not the previews
+    // computed while a slider is dragged, nor the levels of a progressive computation)
+    bool stored_on_disk = scale == 1 && job.scale == 1;
+    if (stored_on_disk && !job.validate_tiles) {
+        StageTimer::Scope scope(stage_timer, "disk cache");
+        if (disk_cache.find(key, cached)) {
+            cache.insert(key, cached);
+            return to_display_image(cached, job);
+        }
+    }
+
+    // the raw disparities are cached: as long as the images and the matching parameters
+    // do not change, we reuse the maps already in the buffer pool (so tuning the
+    // wls-filter parameters only runs the filter)
+    // the matcher runs without its speckle filter, which we apply afterwards, so tuning
+    // the speckle filter does not match the images again either
+    SGBMParams raw_params = params.raw_matching();
+    cv::Mat raw_disparity = region_buffer("raw_disparity", size, region, CV_16SC1);  // 16 bits, signed
+    bool compute_left = !is_cached(left_cache, scale, raw_params, job, region);
+
+    // the right matcher is created once, and only its parameters are updated
+    // (the right view is only needed by the wls-filter: the matcher checks the left and right
+    // disparities itself)
+    SGBMParams right_params = params.right_view();
+    cv::Mat disparity_right_16S = region_buffer("disparity_right", size, region, CV_16SC1);
+    bool compute_right = job.type == FILTERED_MAP &&
+                         !is_cached(right_cache, scale, right_params, job, region);
+
+    // with the SGM engine, each pyramid level keeps the costs of its images, so a new
+    // penalty only aggregates them again, at each level of a progressive computation
+    SGMEngine &left_engine = left_engines[scale];
+    SGMEngine &right_engine = right_engines[scale];
+    TiledMatcher &left_strips = left_tiles[scale];
+    TiledMatcher &right_strips = right_tiles[scale];
+    left_engine.set_cost_volume_budget(job.cost_volume_budget);
+    right_engine.set_cost_volume_budget(job.cost_volume_budget);
+    left_strips.set_cost_volume_budget(job.cost_volume_budget);
+    right_strips.set_cost_volume_budget(job.cost_volume_budget);
+    left_engine.set_memory_limit(job.memory_limit);
+    right_engine.set_memory_limit(job.memory_limit);
+    left_strips.set_memory_limit(job.memory_limit);
+    right_strips.set_memory_limit(job.memory_limit);
+
+    // the thread pool running the strips of the tiled matchers
+    if (!thread_pool || thread_pool->size() != job.max_threads)
+        thread_pool.reset(new ThreadPool(job.max_threads));
+
+    // when both views must be matched, and we are allowed more than one thread, the right
+    // view is matched in a second thread (with its own matcher) while this one does the left view
+    std::thread right_thread;
+    cv::Exception right_error;
+    bool right_failed = false;
+    if (compute_right && compute_left && job.max_threads > 1) {
+        right_thread = std::thread([&]() {
+            try {
+                StageTimer::Scope scope(stage_timer, "match right");
+                match(right_params, rightState, right_engine, right_strips, right, left, disparity_right_16S, job);
+            } catch (const cv::Exception &e) {
+                right_error = e;
+                right_failed = true;
+            }
+        });
+        compute_right = false;
+    }
+
+    if (compute_left) {
+        try {
+            StageTimer::Scope scope(stage_timer, "match");
+            match(raw_params, bmState, left_engine, left_strips, left, right, raw_disparity, job);
+        } catch (...) {
+            if (right_thread.joinable())
+                right_thread.join();
+            throw;
+        }
+        left_cache[scale] = CachedMatch(raw_params, job, region);
+    }
+
+    if (right_thread.joinable()) {
+        right_thread.join();
+        if (right_failed)
+            throw right_error;
+        right_cache[scale] = CachedMatch(right_params, job, region);
+    }
+
+    if (compute_right) {
+        StageTimer::Scope scope(stage_timer, "match right");
+        match(right_params, rightState, right_engine, right_strips, right, left, disparity_right_16S, job);
+        right_cache[scale] = CachedMatch(right_params, job, region);
+    }
+
+    cv::Mat disparity_16S = region_buffer("disparity", size, region, CV_16SC1);
+    {
+        // the speckle filter needs 9 bytes per pixel (see cv::filterSpeckles)
+        StageTimer::Scope scope(stage_timer, "post-process");
+        cv::Mat speckle_buffer = buffer_pool.get("speckle_buffer", 1, size.area() * 9, CV_8UC1)
+                                            .colRange(0, region.area() * 9);
+        post_process(params, raw_disparity, disparity_16S, speckle_buffer);
+    }
+
+    if (job.type == DEPTH_MAP) {
+        const cv::Mat &map = composite(disparity_16S, roi, region, params, size);
+        validate_batch_path(job, scale, map);
+        cache.insert(key, map);
+        if (stored_on_disk)
+            disk_cache.insert(key, map);
+        return to_display_image(map, job);
+    }
+
+    // the wls-filter reads the disparity range and block size of the matcher when it
+    // is created, so we create a new one when they change
+    cv::Mat filtered_disparity = region_buffer("filtered_disparity", size, region, CV_16SC1);
+    {
+        StageTimer::Scope scope(stage_timer, "wls filter");
+        if (wls_filter.empty() || !wls_filter_params.same_matching(params)) {
+            wls_filter = cv::ximgproc::createDisparityWLSFilter(params.create_matcher());
+            wls_filter_params = params;
+        }
+        params.apply_to(wls_filter);
+        wls_filter->filter(disparity_16S, left, filtered_disparity, disparity_right_16S);
+    }
+
+    const cv::Mat &map = composite(filtered_disparity, roi, region, params, size);
+    validate_batch_path(job, scale, map);
+    cache.insert(key, map);
+    if (stored_on_disk)
+        disk_cache.insert(key, map);
+    return to_display_image(map, job);
+}
+
+// we compute one disparity map, either in one piece, or strip by strip on the thread pool
+void DepthMapWorker::match(const SGBMParams &params, cv::Ptr<cv::StereoSGBM> &matcher, SGMEngine &engine,
+                           TiledMatcher &tiles, const cv::Mat &first, const cv::Mat &second, cv::Mat &disparity,
+                           const Job &job)
+{
+    if (!job.tiled || job.max_threads < 2) {
+        match_whole(params, matcher, engine, first, second, disparity);
+        return;
+    }
+
+    tiles.set_overlap(job.tile_overlap);
+    tiles.compute(params, first, second, disparity, *thread_pool);
+
+    // in validation mode, we also compute the map in one piece, and report the difference
+    if (job.validate_tiles) {
+        cv::Mat reference;
+        match_whole(params, matcher, engine, first, second, reference);
+
+        TiledMatcher::Validation validation = TiledMatcher::compare(disparity, reference);
+        emit status_message(QString("tiles: %1 pixels (%2%) differ from the monolithic map, by at most %3 px")
+                            .arg(validation.differing_pixels)
+                            .arg(100.0 * validation.differing_ratio, 0, 'f', 2)
+                            .arg(validation.max_difference / 16.0));
+    }
+}
+
+// in validation mode, we compare a map at full resolution with the one the tools without GUI
+// (SGBMBatch, SGBMAutoTune, StereoBench) compute from the same images and parameters, which
+// should be identical; only the maps of the whole images matched in one piece are compared,
+// since the tiles and the regions of interest change them slightly
+void DepthMapWorker::validate_batch_path(const Job &job, int scale, const cv::Mat &map)
+{
+    if (!job.validate_tiles || scale != 1 || !job.roi.empty() || (job.tiled && job.max_threads >= 2))
+        return;
+
+    StageTimer::Scope scope(stage_timer, "validation");
+    cv::Mat reference;
+    if (job.type == FILTERED_MAP)
+        compute_filtered_disparity(job.params, job.left_image, job.right_image, reference);
+    else
+        compute_disparity(job.params, job.left_image, job.right_image, reference);
+
+    TiledMatcher::Validation validation = TiledMatcher::compare(map, reference);
+    emit status_message(QString("batch tools: %1 pixels (%2%) differ from the tuner, by at most %3 px")
+                        .arg(validation.differing_pixels)
+                        .arg(100.0 * validation.differing_ratio, 0, 'f', 2)
+                        .arg(validation.max_difference / 16.0));
+}
+
+// the matcher and the engine are kept between two calls, only the one of the parameters is used
+void DepthMapWorker::match_whole(const SGBMParams &params, cv::Ptr<cv::StereoSGBM> &matcher, SGMEngine &engine,
+                                 const cv::Mat &first, const cv::Mat &second, cv::Mat &disparity)
+{
+    if (params.engine == SGBMParams::ENGINE_SGM) {
+        engine.compute(params, first, second, disparity);
+    } else {
+        params.apply_to(matcher);
+        matcher->compute(first, second, disparity);
+    }
+}
+
+// the tiling is the one of cache_key(): the number of threads and the overlap only matter
+// when the images are tiled
+DepthMapWorker::CachedMatch::CachedMatch(const SGBMParams &params, const Job &job, const cv::Rect &region) :
+    params(params),
+    image_generation(job.image_generation),
+    region(region),
+    strips(job.tiled && job.max_threads >= 2 ? job.max_threads : 0),
+    tile_overlap(strips > 0 ? job.tile_overlap : 0),
+    validated(strips > 0 && job.validate_tiles)
+{
+}
+
+// true if the buffer of this pyramid level already holds the disparity computed
+// with these parameters and this tiling on the same region of the current images
+// (in validation mode, a tiled map must have been validated)
+bool DepthMapWorker::is_cached(const std::map<int, CachedMatch> &cache, int scale,
+                               const SGBMParams &params, const Job &job, const cv::Rect &region)
+{
+    std::map<int, CachedMatch>::const_iterator it = cache.find(scale);
+    if (it == cache.end())
+        return false;
+    const CachedMatch &cached = it->second;
+    CachedMatch wanted(params, job, region);
+    return cached.image_generation == wanted.image_generation &&
+           cached.region == wanted.region &&
+           cached.strips == wanted.strips &&
+           cached.tile_overlap == wanted.tile_overlap &&
+           (cached.validated || !wanted.validated) &&
+           cached.params.same_matching(params);
+}
+
+// the key of a map in the cache: the images, the type of map, the pyramid level, the
+// parameters it depends on, and the tiling (which changes the maps slightly)
+std::string DepthMapWorker::cache_key(const Job &job, int scale, const SGBMParams &params)
+{
+    std::ostringstream key;
+    key << image_key << " " << (job.type == FILTERED_MAP ? "wls" : "raw") << " " << scale << " "
+        << (job.type == FILTERED_MAP ? params.key() : params.matching_key());
+    if (job.tiled && job.max_threads >= 2)
+        key << " tiled " << job.max_threads << " " << job.tile_overlap;
+    if (!job.roi.empty())
+        key << " roi " << job.roi.x << " " << job.roi.y << " " << job.roi.width << " " << job.roi.height;
+    return key.str();
+}
+
+// the region of interest at a pyramid level (the whole image if there is none)
+cv::Rect DepthMapWorker::scaled_roi(const Job &job, int scale, const cv::Size &size)
+{
+    cv::Rect image(0, 0, size.width, size.height);
+    if (job.roi.empty())
+        return image;
+    cv::Rect roi(job.roi.x / scale, job.roi.y / scale,
+                 (job.roi.width + scale - 1) / scale, (job.roi.height + scale - 1) / scale);
+    roi &= image;
+    return roi.empty() ? image : roi;
+}
+
+// the part of the images matched for a region of interest
+// a pixel of the left view is compared to the pixels of the right view up to
+// min_disparity + num_disparities - 1 columns on its left (and -min_disparity on its
+// right), the matcher marks the first columns of the images as invalid, and the
+// blocks extend by half a block size around each pixel; for the wls-filter, the right
+// view is matched as well, which needs the same margin on the other side
+cv::Rect DepthMapWorker::matching_region(const Job &job, const cv::Rect &roi, const SGBMParams &params,
+                                         const cv::Size &size)
+{
+    int max_disparity = std::max(0, params.min_disparity + params.num_disparities);
+    int left_margin = max_disparity + params.block_size;
+    int right_margin = std::max(0, -params.min_disparity) + params.block_size;
+    if (job.type == FILTERED_MAP)
+        right_margin = std::max(right_margin, left_margin);
+    int vertical_margin = params.block_size;
+
+    cv::Rect region(roi.x - left_margin, roi.y - vertical_margin,
+                    roi.width + left_margin + right_margin, roi.height + 2 * vertical_margin);
+    return region & cv::Rect(0, 0, size.width, size.height);
+}
+
+// a buffer of the pool for the matched region: a view of a buffer of the size of the pyramid
+// level, so that a region changing with the parameters does not allocate new buffers
+// (the matchers and filters write into a view of the right size without reallocating it)
+cv::Mat DepthMapWorker::region_buffer(const std::string &name, const cv::Size &size, const cv::Rect &region,
+                                      int type)
+{
+    return buffer_pool.get(name, size, type)(cv::Rect(0, 0, region.width, region.height));
+}
+
+// we place the map of the matched region in a map of the whole image, where the
+// pixels outside the region of interest are invalid
+const cv::Mat &DepthMapWorker::composite(const cv::Mat &disparity, const cv::Rect &roi, const cv::Rect &region,
+                                         const SGBMParams &params, const cv::Size &size)
+{
+    if (roi.size() == size)
+        return disparity;
+
+    cv::Mat &full = buffer_pool.get("composite", size, CV_16SC1);
+    full.setTo(cv::Scalar((params.min_disparity - 1) * 16));
+    disparity(roi - region.tl()).copyTo(full(roi));
+    return full;
+}
+
+// we convert the depth map to a QImage, to display it in the GUI
+// (QPixmap can only be used in the GUI thread, so the GUI does that last step)
+// the image is resized to fit in the GUI, but never beyond the size of the full resolution map,
+// so that the previews computed on downscaled images are displayed at the same size
+QImage DepthMapWorker::to_display_image(const cv::Mat &disparity, const Job &job)
+{
+    QSize size = job.display_size.boundedTo(QSize(job.left_image.cols, job.left_image.rows));
+    disparity_view.set_colormap(job.colormap);
+    return disparity_view.render(disparity, size, stage_timer);
+}
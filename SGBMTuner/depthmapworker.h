@@ -0,0 +1,229 @@
+#ifndef DEPTHMAPWORKER_H
+#define DEPTHMAPWORKER_H
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/ximgproc/disparity_filter.hpp"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+#include <QSize>
+
+#include <map>
+#include <memory>
+
+#include "bufferpool.h"
+#include "disparitycache.h"
+#include "disparityview.h"
+#include "diskcache.h"
+#include "sgbmparams.h"
+#include "sgmengine.h"
+#include "stagetimer.h"
+#include "threadpool.h"
+#include "tiledmatcher.h"
+
+// the thread that computes the depth maps, so that the GUI never blocks
+// while OpenCV is working
+//
+// the GUI sends requests (a type of map and a snapshot of the parameters),
+// and the worker only keeps the latest one: if several requests arrive while
+// a map is being computed, all but the last one are dropped, so we never
+// compute a map for a slider position that the user has already left
+class DepthMapWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum JobType {
+        DEPTH_MAP,     // raw semi-global block-matching disparity
+        FILTERED_MAP   // disparity post-processed with the wls-filter
+    };
+
+    explicit DepthMapWorker(QObject *parent = 0);
+    ~DepthMapWorker();
+
+    // the images must not be modified after being handed to the worker
+    // (we only keep a reference to their data)
+    void set_images(const cv::Mat &left, const cv::Mat &right);
+
+    // the maximum size of the image sent back to the GUI
+    void set_display_size(const QSize &size);
+
+    // we replace any pending request with this one, and wake the worker up
+    // with a scale > 1, the map is computed on downscaled images (fast preview)
+    void request(JobType type, const SGBMParams &params, int scale = 1);
+
+    // in progressive mode, a map is first computed on a downscaled pyramid level,
+    // displayed, then refined level by level up to the requested resolution
+    // (the refinement is abandoned as soon as a newer request arrives)
+    void set_progressive(bool enabled);
+
+    // display the maps with a color map instead of grayscale
+    void set_colormap(bool enabled);
+
+    // the maximum number of threads used for one computation
+    // (with at least 2, the left and right views of the wls-filter are matched concurrently)
+    void set_max_threads(int count);
+
+    // in tiled mode, the images are matched strip by strip on a thread pool
+    // (overlap: rows shared by two strips, -1 for automatic)
+    // in validation mode, the tiled maps are also computed in one piece, the other maps at full
+    // resolution like the tools without GUI do (see compute_disparity() in stereomatch.h), and
+    // the difference is reported
+    void set_tiled(bool enabled, int overlap, bool validate);
+
+    // only this region of the left image is matched (in pixels of the full resolution
+    // images, empty for the whole image); the map of the region is displayed at its
+    // place in the full image, the rest being invalid
+    void set_roi(const cv::Rect &roi);
+
+    // the memory the SGM engine may use to keep the costs of each view between two
+    // computations, so that tuning P1, P2 or the uniqueness ratio only aggregates them
+    // again (0 to never keep them; see SGMEngine::set_cost_volume_budget())
+    void set_cost_volume_budget(size_t bytes);
+
+    // the memory the SGM engine may use to match each view (0 for no limit): with 8 paths,
+    // the images are then aggregated in bands of rows (see SGMEngine::set_memory_limit())
+    void set_memory_limit(size_t bytes);
+
+    // statistics about the requests: how many maps were computed,
+    // and how many requests were replaced by a newer one before being started
+    int completed_jobs();
+    int dropped_jobs();
+
+    // the number of buffers allocated by the last job, including the images sent to the GUI
+    // (0 in steady state, when the images and the parameters affecting the sizes do not change)
+    int allocations_per_job();
+
+    // the memory the cache of computed maps may use (0 disables it), and its hits and misses
+    void set_cache_budget(size_t bytes);
+    DisparityCache::Statistics cache_statistics() const;
+
+    // the maps at full resolution are also kept on disk, in this directory, from
+    // one session to the next (an empty directory closes the disk cache)
+    bool set_disk_cache(const std::string &directory, size_t budget_bytes);
+    void set_disk_cache_budget(size_t bytes);
+    DiskCache::Statistics disk_cache_statistics() const;
+
+    // the timer receiving the duration of each stage of the computation
+    // (must be set before the thread is started, and outlive it)
+    void set_stage_timer(StageTimer *timer);
+
+    // we ask the thread to terminate, and wait for it
+    void stop();
+
+signals:
+    // emitted (from the worker thread) when a map has been computed
+    void map_ready(const QImage &image);
+
+    // emitted (from the worker thread) with information about the computation
+    void status_message(const QString &message);
+
+    // emitted (from the worker thread) when OpenCV refused to compute a map
+    void compute_failed(const QString &message);
+
+protected:
+    void run();
+
+private:
+    struct Job {
+        JobType type;
+        SGBMParams params;
+        int scale;
+        cv::Mat left_image;
+        cv::Mat right_image;
+        int image_generation;  // changes every time new images are set
+        QSize display_size;
+        bool colormap;
+        int max_threads;
+        bool tiled;
+        int tile_overlap;
+        bool validate_tiles;
+        cv::Rect roi;
+        size_t cost_volume_budget;
+        size_t memory_limit;
+    };
+
+    // shared with the GUI thread, protected by the mutex
+    QMutex mutex;
+    QWaitCondition condition;
+    bool has_pending_job;
+    int image_generation;
+    bool stopping;
+    bool progressive;
+    Job pending_job;
+    int completed_job_count;
+    int dropped_job_count;
+    int last_job_allocations;
+    cv::Mat left_image;
+    cv::Mat right_image;
+    QSize display_size;
+    bool colormap;
+    int max_threads;
+    bool tiled;
+    int tile_overlap;
+    bool validate_tiles;
+    cv::Rect roi;
+    size_t cost_volume_budget;
+    size_t memory_limit;
+
+    // what a disparity buffer of the pool currently holds
+    struct CachedMatch {
+        CachedMatch() : image_generation(-1), strips(0), tile_overlap(0), validated(false) {}
+        CachedMatch(const SGBMParams &params, const Job &job, const cv::Rect &region);
+        SGBMParams params;
+        int image_generation;
+        cv::Rect region;  // the part of the images matched
+        int strips;       // the tiling, which changes the maps slightly (0: in one piece)
+        int tile_overlap;
+        bool validated;   // the tiles were compared with the map in one piece
+    };
+
+    // only used from the worker thread
+    StageTimer *stage_timer;
+    cv::Ptr<cv::StereoSGBM> bmState;
+    cv::Ptr<cv::StereoSGBM> rightState;
+    std::map<int, SGMEngine> left_engines;   // by pyramid level, each keeping its costs
+    std::map<int, SGMEngine> right_engines;  // (used instead of the matchers with ENGINE_SGM)
+    cv::Ptr<cv::ximgproc::DisparityWLSFilter> wls_filter;
+    SGBMParams wls_filter_params;  // the matching parameters the filter was created with
+    std::map<int, CachedMatch> left_cache;   // by pyramid level
+    std::map<int, CachedMatch> right_cache;
+    std::unique_ptr<ThreadPool> thread_pool;
+    std::map<int, TiledMatcher> left_tiles;  // by pyramid level
+    std::map<int, TiledMatcher> right_tiles;
+    DisparityView disparity_view;
+    BufferPool buffer_pool;
+    cv::Size buffer_pool_image_size;
+    std::string image_key;         // the hash of the images of image_key_generation
+    int image_key_generation;
+
+    // the maps computed recently (used from both threads, it has its own lock)
+    DisparityCache cache;
+    DiskCache disk_cache;
+
+    bool is_cancelled();
+    int coarsest_scale(const Job &job);
+    bool has_cached_map(const Job &job);
+    QImage compute(const Job &job, int scale);
+    void match(const SGBMParams &params, cv::Ptr<cv::StereoSGBM> &matcher, SGMEngine &engine,
+               TiledMatcher &tiles, const cv::Mat &first, const cv::Mat &second, cv::Mat &disparity,
+               const Job &job);
+    void match_whole(const SGBMParams &params, cv::Ptr<cv::StereoSGBM> &matcher, SGMEngine &engine,
+                     const cv::Mat &first, const cv::Mat &second, cv::Mat &disparity);
+    void validate_batch_path(const Job &job, int scale, const cv::Mat &map);
+    cv::Mat region_buffer(const std::string &name, const cv::Size &size, const cv::Rect &region, int type);
+    bool is_cached(const std::map<int, CachedMatch> &cache, int scale,
+                   const SGBMParams &params, const Job &job, const cv::Rect &region);
+    std::string cache_key(const Job &job, int scale, const SGBMParams &params);
+    static cv::Rect scaled_roi(const Job &job, int scale, const cv::Size &size);
+    static cv::Rect matching_region(const Job &job, const cv::Rect &roi, const SGBMParams &params,
+                                    const cv::Size &size);
+    const cv::Mat &composite(const cv::Mat &disparity, const cv::Rect &roi, const cv::Rect &region,
+                             const SGBMParams &params, const cv::Size &size);
+    QImage to_display_image(const cv::Mat &disparity, const Job &job);
+};
+
+#endif // DEPTHMAPWORKER_H
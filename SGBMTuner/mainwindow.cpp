@@ -2,10 +2,17 @@
 #include "ui_mainwindow.h"
 #include <ostream>
 #include <string>
+#include <QFileInfo>
+#include <QMouseEvent>
+#include <QStatusBar>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    stream_frames(0),
+    stream_fps(0),
+    comparison(0),
+    real_time_flag(false)
 {
     ui->setupUi(this);
     bmState = cv::StereoSGBM::create(-16, 128, 11);
@@ -47,11 +54,71 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->horizontalSlider_WLS_lambda->setValue(wls_filter->getLambda());
     ui->horizontalSlider_WLS_sigma->setValue(wls_filter->getSigmaColor()*10);
 
+    // the SGM engine runs on the fastest instruction set of this processor
+    ui->comboBox_engine->setItemText(SGBMParams::ENGINE_SGM,
+                                     QString("SGM engine (%1)").arg(simd_isa_name(best_simd_isa())));
+
     real_time_flag = false;
+
+    // the depth maps are computed in a background thread, and sent back to the GUI
+    // through queued connections, so that the sliders stay responsive
+    depth_worker = new DepthMapWorker(this);
+    depth_worker->set_display_size(ui->label_depth_map->maximumSize());
+    depth_worker->set_progressive(ui->checkBox_progressive->isChecked());
+    depth_worker->set_stage_timer(&stage_timer);
+    depth_worker->set_cache_budget(size_t(ui->spinBox_cache->value()) << 20);
+    depth_worker->set_cost_volume_budget(size_t(ui->spinBox_cost_volume->value()) << 20);
+    depth_worker->set_memory_limit(size_t(ui->spinBox_memory_limit->value()) << 20);
+    on_spinBox_disk_cache_valueChanged(ui->spinBox_disk_cache->value());
+    ui->spinBox_threads->setValue(QThread::idealThreadCount());
+    connect(depth_worker, SIGNAL(map_ready(QImage)), this, SLOT(display_depth_map(QImage)), Qt::QueuedConnection);
+    connect(depth_worker, SIGNAL(compute_failed(QString)), this, SLOT(display_compute_error(QString)), Qt::QueuedConnection);
+    connect(depth_worker, SIGNAL(status_message(QString)), statusBar(), SLOT(showMessage(QString)), Qt::QueuedConnection);
+    depth_worker->start();
+
+    // the slider callbacks go through the scheduler, which collapses bursts of changes
+    // and computes fast previews while a slider is being dragged
+    scheduler = new ComputeScheduler(depth_worker, this);
+    scheduler->set_debounce_interval(ui->spinBox_debounce->value());
+    foreach (QSlider *slider, ui->centralWidget->findChildren<QSlider *>()) {
+        connect(slider, SIGNAL(sliderPressed()), scheduler, SLOT(begin_drag()));
+        connect(slider, SIGNAL(sliderReleased()), scheduler, SLOT(end_drag()));
+    }
+
+    statistics_label = new QLabel(this);
+    statusBar()->addPermanentWidget(statistics_label);
+    // the pictures are decoded in the background
+    image_loader = new ImageLoader(this);
+    image_loader->set_stage_timer(&stage_timer);
+    connect(image_loader, SIGNAL(loaded(LoadedImage)), this, SLOT(display_loaded_image(LoadedImage)), Qt::QueuedConnection);
+    image_loader->start();
+
+    timing_label = new QLabel(this);
+    timing_label->setToolTip("median / 95th percentile of the last durations of each stage");
+    statusBar()->addPermanentWidget(timing_label);
+
+    // the frames of a video go through their own pipeline, with the parameters of the sliders
+    stream = new StreamPipeline(this);
+    stream->set_display_size(ui->label_depth_map->maximumSize());
+    stream->set_stage_timer(&stage_timer);
+    stream->set_frame_rate(ui->spinBox_stream_fps->value());
+    connect(stream, SIGNAL(frame_ready(QImage,QImage,int)), this, SLOT(display_stream_frame(QImage,QImage,int)), Qt::QueuedConnection);
+    connect(stream, SIGNAL(compute_failed(QString)), this, SLOT(display_compute_error(QString)), Qt::QueuedConnection);
+    connect(stream, SIGNAL(finished(int)), this, SLOT(stream_finished(int)), Qt::QueuedConnection);
+    stream_label = new QLabel(this);
+    statusBar()->addPermanentWidget(stream_label);
+    connect(scheduler, SIGNAL(statistics_changed()), this, SLOT(display_statistics()));
+
+    // a rectangle dragged on the left picture restricts the matching to that region
+    roi_band = new QRubberBand(QRubberBand::Rectangle, ui->label_image_left);
+    ui->label_image_left->installEventFilter(this);
 }
 
 MainWindow::~MainWindow()
 {
+    image_loader->stop();
+    stream->stop();
+    depth_worker->stop();
     delete ui;
 }
 
@@ -61,35 +128,18 @@ void MainWindow::on_pushButton_left_clicked()
 {
     // we prompt the user with a file dialog,
     // to select the picture file from the left camera
-    QString filename = QFileDialog::getOpenFileName(this, "Select left picture file", QDir::homePath(), NULL);
+    QString filename = QFileDialog::getOpenFileName(this, "Select left picture file (or raw stereo capture)", QDir::homePath(), NULL);
     if (filename.isNull() || filename.isEmpty())
         return;
 
-    ///// Qt display stuff
-
-    // we load the picture from the file, to display it in a QLabel in the GUI
-    QImage left_picture;
-    left_picture.load(filename);
-
-    // some computation to resize the image if it is too big to fit in the GUI
-    QPixmap left_pixmap = QPixmap::fromImage(left_picture);
-    int max_width  = std::min(ui->label_image_left->maximumWidth(), left_picture.width());
-    int max_height = std::min(ui->label_image_left->maximumHeight(), left_picture.height());
-    ui->label_image_left->setPixmap(left_pixmap.scaled(max_width, max_height, Qt::KeepAspectRatio));
-
-    set_SADWindowSize();  // the SAD window size parameter depends on the size of the image
-
-    ///// OpenCV disparity map computation
-
-    // we convert filename from QString to std::string (needed by OpenCV)
-    std::string filename_s = filename.toUtf8().constData();
-
-    // we load the picture in the OpenCV Mat format, to compute depth map
-    cv::Mat mat = cv::imread(filename_s, CV_LOAD_IMAGE_COLOR);
-    cv::cvtColor(mat, mat, CV_BGR2GRAY);  // we convert to gray, needed to compute depth map
-    this->left_image = mat;
+    if (RawStereoFile::is_raw_stereo(filename.toUtf8().constData())) {
+        load_raw_capture(filename);
+        return;
+    }
 
-    compute_depth_map();
+    // the picture is decoded in the background, and sent back to display_loaded_image()
+    image_loader->load(filename, LEFT_VIEW, ui->label_image_left->maximumSize());
+    ui->label_image_left->setText("loading " + QFileInfo(filename).fileName() + "...");
 }
 
 // method called when the button to change the right image is clicked
@@ -98,34 +148,77 @@ void MainWindow::on_pushButton_right_clicked()
 {
     // we prompt the user with a file dialog,
     // to select the picture file from the left camera
-    QString filename = QFileDialog::getOpenFileName(this, "Select right picture file", QDir::homePath(), NULL);
+    QString filename = QFileDialog::getOpenFileName(this, "Select right picture file (or raw stereo capture)", QDir::homePath(), NULL);
     if (filename.isNull() || filename.isEmpty())
         return;
 
-    ///// Qt display stuff
-
-    // we load the picture from the file, to display it in a QLabel in the GUI
-    QImage right_picture;
-    right_picture.load(filename);
+    if (RawStereoFile::is_raw_stereo(filename.toUtf8().constData())) {
+        load_raw_capture(filename);
+        return;
+    }
 
-    // some computation to resize the image if it is too big to fit in the GUI
-    QPixmap right_pixmap = QPixmap::fromImage(right_picture);
-    int max_width  = std::min(ui->label_image_right->maximumWidth(), right_picture.width());
-    int max_height = std::min(ui->label_image_right->maximumHeight(), right_picture.height());
-    ui->label_image_right->setPixmap(right_pixmap.scaled(max_width, max_height, Qt::KeepAspectRatio));
+    // the picture is decoded in the background, and sent back to display_loaded_image()
+    image_loader->load(filename, RIGHT_VIEW, ui->label_image_right->maximumSize());
+    ui->label_image_right->setText("loading " + QFileInfo(filename).fileName() + "...");
+}
 
-    set_SADWindowSize();  // the SAD window size parameter depends on the size of the image
+// called (through a queued connection) when the loader has decoded a picture
+// the preview and the matched picture come from a single decode
+void MainWindow::display_loaded_image(const LoadedImage &loaded)
+{
+    QLabel *label = loaded.target == LEFT_VIEW ? ui->label_image_left : ui->label_image_right;
+    if (!loaded.error.isEmpty()) {
+        label->setText(loaded.error);
+        return;
+    }
 
-    ///// OpenCV disparity map computation
+    label->setPixmap(QPixmap::fromImage(loaded.preview));
+    if (loaded.target == LEFT_VIEW) {
+        left_image = loaded.image;
+        set_roi(cv::Rect());
+    } else
+        right_image = loaded.image;
+    depth_worker->set_images(left_image, right_image);
+    if (comparison)
+        comparison->set_images(left_image, right_image);
 
-    // we convert filename from QString to std::string (needed by OpenCV)
-    std::string filename_s = filename.toUtf8().constData();
+    set_SADWindowSize();  // the SAD window size parameter depends on the size of the image
+    update_memory_estimate();
+    compute_depth_map();
+}
 
-    // we load the picture in the OpenCV Mat format, to compute depth map
-    cv::Mat mat = cv::imread(filename_s, CV_LOAD_IMAGE_COLOR);
-    cv::cvtColor(mat, mat, CV_BGR2GRAY);  // we convert to gray, needed to compute depth map
-    this->right_image = mat;
+// we load both views from the first frame of a raw capture
+// the frames are matched straight from the memory mapping, so nothing is decoded
+void MainWindow::load_raw_capture(const QString &filename)
+{
+    RawStereoFile capture;
+    cv::Mat left, right;
+    {
+        StageTimer::Scope scope(stage_timer, "decode");
+        if (!capture.open(filename.toUtf8().constData()) || !capture.frame(0, left, right)) {
+            statusBar()->showMessage("Can't read the raw stereo capture " + filename);
+            return;
+        }
+    }
+    statusBar()->showMessage(QString("frame 1 of %1 (open the capture as a stream to play it)").arg(capture.frame_count()));
+
+    // the frames keep the capture mapped (see RawStereoFile::frame()), so it is unmapped
+    // once the images are replaced and no computation still uses them
+    left_image = left;
+    right_image = right;
+    set_roi(cv::Rect());
+
+    {
+        StageTimer::Scope scope(stage_timer, "preview");
+        ui->label_image_left->setPixmap(QPixmap::fromImage(preview_image(left_image, ui->label_image_left->maximumSize())));
+        ui->label_image_right->setPixmap(QPixmap::fromImage(preview_image(right_image, ui->label_image_right->maximumSize())));
+    }
+    depth_worker->set_images(left_image, right_image);
+    if (comparison)
+        comparison->set_images(left_image, right_image);
 
+    set_SADWindowSize();
+    update_memory_estimate();
     compute_depth_map();
 }
 
@@ -134,81 +227,256 @@ void MainWindow::on_pushButton_wls_filter_clicked()
     compute_filter_map();
 }
 
-// we compute the depth map, if both left image and right image have been added
-void MainWindow::compute_depth_map() {
+// we save the current parameters in a YAML file, to use them with the command-line tools
+void MainWindow::on_pushButton_save_params_clicked()
+{
+    QString filename = QFileDialog::getSaveFileName(this, "Save parameters", QDir::homePath(), "Parameters (*.yml *.yaml *.xml)");
+    if (filename.isNull() || filename.isEmpty())
+        return;
+
+    SGBMParams params = current_params();
+    if (!params.save(filename.toUtf8().constData()))
+        statusBar()->showMessage("Can't write " + filename);
+}
+
+// we load parameters from a file, through the sliders (so that their constraints are applied)
+void MainWindow::on_pushButton_load_params_clicked()
+{
+    QString filename = QFileDialog::getOpenFileName(this, "Load parameters", QDir::homePath(), "Parameters (*.yml *.yaml *.xml)");
+    if (filename.isNull() || filename.isEmpty())
+        return;
+
+    SGBMParams params;
+    if (!SGBMParams::load(filename.toUtf8().constData(), params)) {
+        statusBar()->showMessage("Can't read " + filename);
+        return;
+    }
+
+    apply_params(params);
+}
+
+void MainWindow::apply_params(const SGBMParams &params)
+{
+    ui->horizontalSlider_pre_filter_cap->setValue(params.pre_filter_cap);
+    ui->horizontalSlider_SAD_window_size->setValue(params.block_size);
+    ui->horizontalSlider_min_disparity->setValue(params.min_disparity);
+    ui->horizontalSlider_num_of_disparity->setValue(params.num_disparities);
+    ui->horizontalSlider_uniqueness_ratio->setValue(params.uniqueness_ratio);
+    ui->horizontalSlider_speckle_window_size->setValue(params.speckle_window_size);
+    ui->horizontalSlider_speckle_range->setValue(params.speckle_range);
+    ui->horizontalSlider_disp_12_max_diff->setValue(params.disp12_max_diff);
+    ui->horizontalSlider_P1->setValue(params.P1);
+    ui->horizontalSlider_P2->setValue(params.P2);
+    ui->horizontalSlider_Mode->setValue(params.mode);
+    ui->horizontalSlider_WLS_lambda->setValue(params.wls_lambda);
+    ui->horizontalSlider_WLS_sigma->setValue(params.wls_sigma * 10);
+    ui->comboBox_engine->setCurrentIndex(params.engine == SGBMParams::ENGINE_SGM ? SGBMParams::ENGINE_SGM
+                                                                                 : SGBMParams::ENGINE_OPENCV);
+    ui->comboBox_cost->setCurrentIndex(params.cost >= 0 && params.cost < SGBMParams::COST_COUNT ? params.cost
+                                                                                           : SGBMParams::COST_CENSUS_5X5);
+}
+
+// the parameters held by the OpenCV objects, and the engine matching with them
+SGBMParams MainWindow::current_params()
+{
+    SGBMParams params = SGBMParams::from_matcher(bmState, wls_filter);
+    params.engine = ui->comboBox_engine->currentIndex();
+    params.cost = ui->comboBox_cost->currentIndex();
+    return params;
+}
+
+// the memory of the matcher of the left view (the wls-filter matches the right one as well,
+// with as much memory), next to the number of disparities and to the mode, which change it the
+// most; with a limit, the mode also shows the bands the SGM engine will aggregate, or the least
+// memory it needs when the limit is too low
+void MainWindow::update_memory_estimate()
+{
+    if (left_image.empty() || ui->horizontalSlider_num_of_disparity->value() <= 0) {
+        ui->label_memory_disparities->clear();
+        ui->label_memory_mode->clear();
+        return;
+    }
+
+    SGBMParams params = current_params();
+    size_t limit = size_t(ui->spinBox_memory_limit->value()) << 20;
+    size_t budget = size_t(ui->spinBox_cost_volume->value()) << 20;
+    size_t bytes = estimate_matching_memory(params, left_image.size(), limit, budget);
+    QString text = QString("%1 MB").arg(bytes / double(1 << 20), 0, 'f', 1);
+    ui->label_memory_disparities->setText(text);
+
+    if (params.engine == SGBMParams::ENGINE_SGM) {
+        SGMEngine::MemoryEstimate estimate = SGMEngine::estimate_memory(left_image.size(), params, limit, budget);
+        if (!estimate.fits)
+            text = QString("over the limit, needs %1 MB").arg(estimate.peak_bytes / double(1 << 20), 0, 'f', 1);
+        else if (estimate.band_rows < left_image.rows)
+            text = QString("%1, bands of %2 rows").arg(text).arg(estimate.band_rows);
+    }
+    ui->label_memory_mode->setText(text);
+}
+
+// we export the percentiles of the stage durations, as JSON or CSV depending on the extension
+void MainWindow::on_pushButton_export_timings_clicked()
+{
+    QString filename = QFileDialog::getSaveFileName(this, "Export timings", QDir::homePath(), "Timings (*.json *.csv)");
+    if (filename.isNull() || filename.isEmpty())
+        return;
+
+    std::string filename_s = filename.toUtf8().constData();
+    bool written = filename.endsWith(".json", Qt::CaseInsensitive) ? stage_timer.export_json(filename_s)
+                                                                   : stage_timer.export_csv(filename_s);
+    if (!written)
+        statusBar()->showMessage("Can't write " + filename);
+}
+
+// we check that both images have been loaded, and that they can be matched
+bool MainWindow::check_images() {
     // we check that both images have been loaded
     if (this->left_image.empty() || this->right_image.empty())
-        return;
+        return false;
 
     // we check that both images have the same size (else OpenCV throws an error)
     if (left_image.rows != right_image.rows || left_image.cols != right_image.cols) {
         ui->label_depth_map->setText("Can't compute depth map: left and right images should be the same size");
-        return;
+        return false;
     }
 
-    // we compute the depth map
-    // cv::Mat disparity_16S;  // 16 bits, signed
-    bmState->compute(left_image, right_image, disparity_16S);
+    return true;
+}
 
-    // we convert the depth map to a QPixmap, to display it in the QUI
-    // first, we need to convert the disparity map to a more regular grayscale format
-    // then, we convert to RGB, and finally, we can convert to a QImage and then a QPixmap
+// we compute the depth map, if both left image and right image have been added
+// the computation is done by the worker thread, which sends the result back to display_depth_map()
+void MainWindow::compute_depth_map() {
+    // while streaming, the parameters apply to the next frames
+    if (stream->is_running()) {
+        stream->set_params(current_params());
+        return;
+    }
 
-    // we normalize the values, so that they all fit in the range [0, 255]
-    cv::Mat disparity_16S_normal;
-    cv::normalize(disparity_16S, disparity_16S_normal, 0, 255, CV_MINMAX);
+    if (!check_images())
+        return;
 
-    // we convert the values from 16 bits signed to 8 bits unsigned
-    cv::Mat disp(disparity_16S.rows, disparity_16S.cols, CV_8UC1);
-    for (int i=0; i<disparity_16S.rows; i++)
-        for (int j=0; j<disparity_16S.cols; j++)
-            disp.at<unsigned char>(i,j) = (unsigned char)disparity_16S_normal.at<short>(i,j);
+    scheduler->request(DepthMapWorker::DEPTH_MAP, current_params());
+}
 
-    // we convert from gray to color
-    cv::Mat disp_color;
-    cv::cvtColor(disp, disp_color, CV_GRAY2RGB);
+// same as above, but the depth map is post-processed with the wls-filter
+// (the frames of a stream are not filtered)
+void MainWindow::compute_filter_map() {
+    if (stream->is_running()) {
+        stream->set_params(current_params());
+        return;
+    }
 
-    // we finally can convert the image to a QPixmap and display it
-    QImage disparity_image = QImage((unsigned char*) disp_color.data, disp_color.cols, disp_color.rows, QImage::Format_RGB888);
-    QPixmap disparity_pixmap = QPixmap::fromImage(disparity_image);
+    if (!check_images())
+        return;
 
-    // some computation to resize the image if it is too big to fit in the GUI
-    int max_width  = std::min(ui->label_depth_map->maximumWidth(),  disparity_image.width());
-    int max_height = std::min(ui->label_depth_map->maximumHeight(), disparity_image.height());
-    ui->label_depth_map->setPixmap(disparity_pixmap.scaled(max_width, max_height, Qt::KeepAspectRatio));
+    scheduler->request(DepthMapWorker::FILTERED_MAP, current_params());
+}
 
+void MainWindow::display_depth_map(const QImage &image) {
+    {
+        StageTimer::Scope scope(stage_timer, "pixmap");
+        ui->label_depth_map->setPixmap(QPixmap::fromImage(image));
+    }
+    display_statistics();
 }
 
-void MainWindow::compute_filter_map() {
+void MainWindow::display_compute_error(const QString &message) {
+    ui->label_depth_map->setText("Can't compute depth map: " + message);
+}
 
-    cv::Mat disparity_right_16S, filtered_disparity, filtered_disparity_normal;
-    rightState = cv::ximgproc::createRightMatcher(bmState);
-    rightState->compute(right_image, left_image, disparity_right_16S);
-    wls_filter->filter(disparity_16S, left_image, filtered_disparity, disparity_right_16S);
+// we start matching the frames of two videos, or of two image sequences (or stop if already running)
+void MainWindow::on_pushButton_stream_clicked()
+{
+    if (stream->is_running()) {
+        stop_stream();
+        return;
+    }
 
-    cv::Mat filtered_disparth_map();
-    cv::normalize(filtered_disparity, filtered_disparity_normal, 0, 255, CV_MINMAX);
+    QString left = QFileDialog::getOpenFileName(this, "Select left video, any image of the left sequence, or a raw stereo capture", QDir::homePath(), NULL);
+    if (left.isNull() || left.isEmpty())
+        return;
 
-    // we convert the values from 16 bits signed to 8 bits unsigned
-    cv::Mat disp(filtered_disparity.rows, filtered_disparity.cols, CV_8UC1);
-    for (int i=0; i<filtered_disparity.rows; i++)
-        for (int j=0; j<filtered_disparity.cols; j++)
-            disp.at<unsigned char>(i,j) = (unsigned char)filtered_disparity_normal.at<short>(i,j);
+    // a raw capture holds both views
+    QString right;
+    if (!RawStereoFile::is_raw_stereo(left.toUtf8().constData())) {
+        right = QFileDialog::getOpenFileName(this, "Select right video, or any image of the right sequence", QFileInfo(left).path(), NULL);
+        if (right.isNull() || right.isEmpty())
+            return;
+    }
 
-    // we convert from gray to color
-    cv::Mat disp_color;
-    cv::cvtColor(disp, disp_color, CV_GRAY2RGB);
+    stream->set_params(current_params());
+    if (!stream->start(left, right)) {
+        statusBar()->showMessage("Can't open the streams " + left + " " + right);
+        return;
+    }
+
+    // we read the frames at the rate they were recorded at, if the video tells it
+    double source_fps = stream->source_frame_rate();
+    if (source_fps > 0)
+        ui->spinBox_stream_fps->setValue(qRound(source_fps));
 
-    // we finally can convert the image to a QPixmap and display it
-    QImage disparity_image = QImage((unsigned char*) disp_color.data, disp_color.cols, disp_color.rows, QImage::Format_RGB888);
-    QPixmap disparity_pixmap = QPixmap::fromImage(disparity_image);
+    stream_clock.start();
+    stream_frames = 0;
+    stream_fps = 0;
+    ui->pushButton_stream->setText("stop stream");
+}
 
-    // some computation to resize the image if it is too big to fit in the GUI
-    int max_width  = std::min(ui->label_depth_map->maximumWidth(),  disparity_image.width());
-    int max_height = std::min(ui->label_depth_map->maximumHeight(), disparity_image.height());
-    ui->label_depth_map->setPixmap(disparity_pixmap.scaled(max_width, max_height, Qt::KeepAspectRatio));
+void MainWindow::stop_stream()
+{
+    stream->stop();
+    ui->pushButton_stream->setText("open stream");
+}
 
+// the end of a stream stopped in the meantime must not stop the one started since
+void MainWindow::stream_finished(int run)
+{
+    if (run == stream->run() && stream->is_running())
+        stop_stream();
+}
 
+void MainWindow::on_spinBox_stream_fps_valueChanged(int value)
+{
+    stream->set_frame_rate(value);
+}
+
+void MainWindow::display_stream_frame(const QImage &left, const QImage &depth_map, int frame_index) {
+    {
+        StageTimer::Scope scope(stage_timer, "stream pixmap");
+        ui->label_image_left->setPixmap(QPixmap::fromImage(left));
+        ui->label_depth_map->setPixmap(QPixmap::fromImage(depth_map));
+    }
+    stream->frame_displayed();
+
+    // the frame rate actually displayed, over about one second
+    stream_frames++;
+    if (stream_clock.elapsed() >= 1000) {
+        stream_fps = stream_frames * 1000.0 / stream_clock.restart();
+        stream_frames = 0;
+    }
+    stream_label->setText(QString("frame: %1  fps: %2  dropped: %3")
+                          .arg(frame_index)
+                          .arg(stream_fps, 0, 'f', 1)
+                          .arg(stream->dropped_frames()));
+    timing_label->setText(QString::fromStdString(stage_timer.summary()));
+}
+
+// how many slider changes were collapsed, instead of being computed
+void MainWindow::display_statistics() {
+    int coalesced = scheduler->coalesced_requests() + depth_worker->dropped_jobs();
+    DisparityCache::Statistics cache = depth_worker->cache_statistics();
+    DiskCache::Statistics disk = depth_worker->disk_cache_statistics();
+    statistics_label->setText(QString("requests: %1  coalesced: %2  computed: %3  allocations: %4  cache: %5 hits / %6 misses (%7 MB)"
+                                      "  disk: %8 hits (%9 MB)")
+                              .arg(scheduler->received_requests())
+                              .arg(coalesced)
+                              .arg(depth_worker->completed_jobs())
+                              .arg(depth_worker->allocations_per_job())
+                              .arg(cache.hits)
+                              .arg(cache.misses)
+                              .arg(cache.bytes / double(1 << 20), 0, 'f', 1)
+                              .arg(disk.hits)
+                              .arg(disk.bytes / double(1 << 20), 0, 'f', 1));
+    timing_label->setText(QString::fromStdString(stage_timer.summary()));
 }
 
 
@@ -252,6 +520,7 @@ void MainWindow::on_horizontalSlider_SAD_window_size_valueChanged(int value)
     }
 
     bmState->setBlockSize(value);
+    update_memory_estimate();
     if(real_time_flag){
         compute_depth_map();
     }
@@ -262,6 +531,7 @@ void MainWindow::on_horizontalSlider_SAD_window_size_valueChanged(int value)
 void MainWindow::on_horizontalSlider_min_disparity_valueChanged(int value)
 {
     bmState->setMinDisparity(value);
+    update_memory_estimate();
     if(real_time_flag){
         compute_depth_map();
     }
@@ -291,6 +561,7 @@ void MainWindow::set_num_of_disparity_slider_to_multiple_16(int value) {
     }
 
     bmState->setNumDisparities(value);
+    update_memory_estimate();
     if(real_time_flag){
         compute_depth_map();
     }
@@ -311,6 +582,7 @@ void MainWindow::on_horizontalSlider_uniqueness_ratio_valueChanged(int value)
 void MainWindow::on_horizontalSlider_speckle_window_size_valueChanged(int value)
 {
     bmState->setSpeckleWindowSize(value);
+    update_memory_estimate();
     if(real_time_flag){
         compute_depth_map();
     }
@@ -331,6 +603,7 @@ void MainWindow::on_horizontalSlider_speckle_range_valueChanged(int value)
 void MainWindow::on_horizontalSlider_disp_12_max_diff_valueChanged(int value)
 {
     bmState->setDisp12MaxDiff(value);
+    update_memory_estimate();
     if(real_time_flag){
         compute_depth_map();
     }
@@ -364,6 +637,29 @@ void MainWindow::on_horizontalSlider_Mode_valueChanged(int value)
 {
     ui->label_Mode_display->setText(QString::number(value));
     bmState->setMode(value);
+    update_memory_estimate();
+    if(real_time_flag){
+        compute_depth_map();
+    }
+}
+
+///// engine
+
+void MainWindow::on_comboBox_engine_currentIndexChanged(int index)
+{
+    ui->comboBox_cost->setEnabled(index == SGBMParams::ENGINE_SGM);  // cv::StereoSGBM has its own
+    update_memory_estimate();
+    if(real_time_flag){
+        compute_depth_map();
+    }
+}
+
+///// matching cost
+
+void MainWindow::on_comboBox_cost_currentIndexChanged(int index)
+{
+    Q_UNUSED(index);
+    update_memory_estimate();
     if(real_time_flag){
         compute_depth_map();
     }
@@ -375,6 +671,9 @@ void MainWindow::on_horizontalSlider_WLS_lambda_valueChanged(int value)
 {
     ui->label_wls_lambda_display->setText(QString::number(value));
     wls_filter->setLambda(value);
+    if(real_time_flag){
+        compute_filter_map();  // the disparities are cached, so only the filter runs again
+    }
 }
 
 ///// WLS_sigma
@@ -382,7 +681,10 @@ void MainWindow::on_horizontalSlider_WLS_lambda_valueChanged(int value)
 void MainWindow::on_horizontalSlider_WLS_sigma_valueChanged(int value)
 {
     ui->label_wls_sigma_display->setText(QString::number(value));
-    wls_filter->setSigmaColor(value/10);
+    wls_filter->setSigmaColor(value/10.0);
+    if(real_time_flag){
+        compute_filter_map();
+    }
 }
 
 
@@ -397,3 +699,155 @@ void MainWindow::on_pushButton_depth_map_clicked()
         compute_depth_map();
     }
 }
+
+void MainWindow::on_checkBox_preview_toggled(bool checked)
+{
+    scheduler->set_preview_scale(checked ? 2 : 1);
+}
+
+void MainWindow::on_spinBox_debounce_valueChanged(int value)
+{
+    scheduler->set_debounce_interval(value);
+}
+
+void MainWindow::on_checkBox_progressive_toggled(bool checked)
+{
+    depth_worker->set_progressive(checked);
+}
+
+void MainWindow::on_checkBox_colormap_toggled(bool checked)
+{
+    depth_worker->set_colormap(checked);
+    stream->set_colormap(checked);
+    if (comparison)
+        comparison->set_colormap(checked);
+    compute_depth_map();
+}
+
+void MainWindow::on_spinBox_cache_valueChanged(int value)
+{
+    depth_worker->set_cache_budget(size_t(value) << 20);
+}
+
+void MainWindow::on_spinBox_cost_volume_valueChanged(int value)
+{
+    depth_worker->set_cost_volume_budget(size_t(value) << 20);
+    update_memory_estimate();
+}
+
+void MainWindow::on_spinBox_memory_limit_valueChanged(int value)
+{
+    depth_worker->set_memory_limit(size_t(value) << 20);
+    update_memory_estimate();
+}
+
+// the maps of the previous sessions are kept in the cache directory of the user
+void MainWindow::on_spinBox_disk_cache_valueChanged(int value)
+{
+    QString directory = value > 0 ? QDir::homePath() + "/.cache/SGBMTuner" : QString();
+    if (!depth_worker->set_disk_cache(directory.toStdString(), size_t(value) << 20))
+        statusBar()->showMessage("can't use the disk cache " + directory);
+}
+
+void MainWindow::on_spinBox_threads_valueChanged(int value)
+{
+    depth_worker->set_max_threads(value);
+}
+
+// the region of interest: a rectangle dragged on the left picture, a click selects
+// the whole picture again
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched != ui->label_image_left || left_image.empty() ||
+            (event->type() != QEvent::MouseButtonPress && event->type() != QEvent::MouseMove &&
+             event->type() != QEvent::MouseButtonRelease))
+        return QMainWindow::eventFilter(watched, event);
+
+    QMouseEvent *mouse = static_cast<QMouseEvent *>(event);
+    QRect shown = displayed_left_image();
+    if (event->type() == QEvent::MouseButtonPress) {
+        if (mouse->button() != Qt::LeftButton)
+            return false;
+        roi_origin = mouse->pos();
+        roi_band->setGeometry(QRect(roi_origin, QSize()));
+        roi_band->show();
+    } else if (event->type() == QEvent::MouseMove) {
+        if (!(mouse->buttons() & Qt::LeftButton))
+            return false;
+        roi_band->setGeometry(QRect(roi_origin, mouse->pos()).normalized() & shown);
+    } else {
+        if (mouse->button() != Qt::LeftButton)
+            return false;
+        QRect selection = roi_band->geometry();
+        if (selection.width() < 4 || selection.height() < 4 || shown.isEmpty()) {
+            set_roi(cv::Rect());
+        } else {
+            // from the preview to the pixels of the picture
+            double scale_x = double(left_image.cols) / shown.width();
+            double scale_y = double(left_image.rows) / shown.height();
+            cv::Rect region(cvRound((selection.x() - shown.x()) * scale_x), cvRound((selection.y() - shown.y()) * scale_y),
+                            cvRound(selection.width() * scale_x), cvRound(selection.height() * scale_y));
+            set_roi(region & cv::Rect(0, 0, left_image.cols, left_image.rows));
+        }
+        compute_depth_map();
+    }
+    return true;
+}
+
+// the preview is centered in its label
+QRect MainWindow::displayed_left_image()
+{
+    const QPixmap *pixmap = ui->label_image_left->pixmap();
+    if (!pixmap || pixmap->isNull())
+        return QRect();
+    QRect shown(QPoint(0, 0), pixmap->size());
+    shown.moveCenter(ui->label_image_left->contentsRect().center());
+    return shown;
+}
+
+void MainWindow::set_roi(const cv::Rect &roi)
+{
+    depth_worker->set_roi(roi);
+    if (roi.area() == 0)
+        roi_band->hide();
+    else
+        statusBar()->showMessage(QString("matching %1x%2 pixels at (%3, %4)").arg(roi.width).arg(roi.height).arg(roi.x).arg(roi.y));
+}
+
+// each click adds the current parameters to the comparison grid
+void MainWindow::on_pushButton_compare_clicked()
+{
+    if (!comparison) {
+        comparison = new ComparisonDialog(this);
+        comparison->set_colormap(ui->checkBox_colormap->isChecked());
+        connect(comparison, SIGNAL(params_selected(SGBMParams)), this, SLOT(apply_params(SGBMParams)));
+    }
+    comparison->set_images(left_image, right_image);
+    if (!comparison->add_cell(current_params()))
+        statusBar()->showMessage(QString("the comparison holds at most %1 sets of parameters").arg(int(ComparisonDialog::MAX_CELLS)));
+    comparison->show();
+    comparison->raise();
+}
+
+void MainWindow::update_tiling()
+{
+    depth_worker->set_tiled(ui->checkBox_tiled->isChecked(),
+                            ui->spinBox_tile_overlap->value(),
+                            ui->checkBox_validate_tiles->isChecked());
+    compute_depth_map();
+}
+
+void MainWindow::on_checkBox_tiled_toggled(bool)
+{
+    update_tiling();
+}
+
+void MainWindow::on_checkBox_validate_tiles_toggled(bool)
+{
+    update_tiling();
+}
+
+void MainWindow::on_spinBox_tile_overlap_valueChanged(int)
+{
+    update_tiling();
+}
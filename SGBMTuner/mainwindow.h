@@ -10,6 +10,21 @@
 
 #include <QMainWindow>
 #include <QFileDialog>
+#include <QLabel>
+#include <QElapsedTimer>
+#include <QRubberBand>
+
+#include "comparisondialog.h"
+#include "computescheduler.h"
+#include "depthmapworker.h"
+#include "imageloader.h"
+#include "previewimage.h"
+#include "rawstereo.h"
+#include "sgbmparams.h"
+#include "sgmkernels.h"
+#include "stagetimer.h"
+#include "stereomatch.h"
+#include "streampipeline.h"
 
 namespace Ui {
 class MainWindow;
@@ -23,13 +38,26 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+protected:
+    // the region of interest is selected with the mouse on the left picture
+    bool eventFilter(QObject *watched, QEvent *event);
+
 private slots:
     void on_pushButton_left_clicked();
 
     void on_pushButton_right_clicked();
 
+    // called (through a queued connection) when the loader has decoded a picture
+    void display_loaded_image(const LoadedImage &loaded);
+
     void on_pushButton_wls_filter_clicked();
 
+    void on_pushButton_save_params_clicked();
+
+    void on_pushButton_load_params_clicked();
+
+    void on_pushButton_export_timings_clicked();
+
     void on_horizontalSlider_num_of_disparity_sliderMoved(int position);
 
     void on_horizontalSlider_num_of_disparity_valueChanged(int value);
@@ -54,6 +82,10 @@ private slots:
 
     void on_horizontalSlider_Mode_valueChanged(int value);
 
+    void on_comboBox_engine_currentIndexChanged(int index);
+
+    void on_comboBox_cost_currentIndexChanged(int index);
+
     void on_horizontalSlider_WLS_lambda_valueChanged(int value);
 
     void on_horizontalSlider_WLS_sigma_valueChanged(int value);
@@ -62,25 +94,110 @@ private slots:
 
     void on_pushButton_depth_map_clicked();
 
+    void on_checkBox_preview_toggled(bool checked);
+
+    void on_spinBox_debounce_valueChanged(int value);
+
+    void on_checkBox_progressive_toggled(bool checked);
+
+    void on_checkBox_colormap_toggled(bool checked);
+
+    void on_spinBox_threads_valueChanged(int value);
+
+    void on_checkBox_tiled_toggled(bool checked);
+
+    void on_checkBox_validate_tiles_toggled(bool checked);
+
+    void on_spinBox_tile_overlap_valueChanged(int value);
+
+    void on_pushButton_stream_clicked();
+
+    void on_spinBox_stream_fps_valueChanged(int value);
+
+    void on_spinBox_cache_valueChanged(int value);
+
+    void on_spinBox_disk_cache_valueChanged(int value);
+
+    void on_spinBox_cost_volume_valueChanged(int value);
+
+    void on_spinBox_memory_limit_valueChanged(int value);
+
+    void on_pushButton_compare_clicked();
+
+    // we set the sliders to these parameters (from a file, or from the comparison grid)
+    void apply_params(const SGBMParams &params);
+
+    // called (through a queued connection) when the worker has finished a map
+    void display_depth_map(const QImage &image);
+    void display_compute_error(const QString &message);
+    void display_statistics();
+
+    // called (through a queued connection) when the stream pipeline has a new frame
+    void display_stream_frame(const QImage &left, const QImage &depth_map, int frame_index);
+    void stop_stream();
+    void stream_finished(int run);
+
 private:
     // the UI object, to access the UI elements created with Qt Designer
     Ui::MainWindow *ui;
 
+    // the views, as targets of the image loader
+    enum View {
+        LEFT_VIEW,
+        RIGHT_VIEW
+    };
+
+    // decodes the pictures in the background
+    ImageLoader *image_loader;
+
     // the left and right pictures, converted to OpenCV Mat format
     cv::Mat left_image;
     cv::Mat right_image;
 
-    cv::Mat disparity_16S;  // 16 bits, signed
-
     // the object that holds the parameters for the semi-global block-matching algorithm
+    // (the matching itself is done by the worker, with its own copy of the parameters)
     cv::Ptr<cv::StereoSGBM> bmState;
-    cv::Ptr<cv::StereoMatcher> rightState;
 
     // the object that holds the parameters for the wls-filter
     cv::Ptr<cv::ximgproc::DisparityWLSFilter> wls_filter;
 
+    // the thread that computes the depth maps in the background
+    DepthMapWorker *depth_worker;
+
+    // collapses the bursts of slider changes before they reach the worker
+    ComputeScheduler *scheduler;
+
+    // the label in the status bar showing the scheduler statistics
+    QLabel *statistics_label;
+
+    // the duration of each stage, from the decoding of the images to the display of the
+    // maps (filled by both the GUI and the worker), and the label showing its percentiles
+    StageTimer stage_timer;
+    QLabel *timing_label;
+
+    // the pipeline matching the frames of a video, and the label showing its frame rate
+    StreamPipeline *stream;
+    QLabel *stream_label;
+    QElapsedTimer stream_clock;  // since the frame rate was last computed
+    int stream_frames;           // frames displayed since then
+    double stream_fps;
+
+    // the grid comparing several sets of parameters (created when first opened)
+    ComparisonDialog *comparison;
+
+    // the rectangle showing the region of interest on the left picture
+    QRubberBand *roi_band;
+    QPoint roi_origin;
+
     void compute_depth_map();  // compute depth map with OpenCV
     void compute_filter_map();  // compute depth map with OpenCV wls filter
+    void load_raw_capture(const QString &filename);  // load both pictures from a raw capture
+    bool check_images();  // check that the images are ready for a computation
+    void update_tiling();  // send the tiling options to the worker
+    void update_memory_estimate();  // display the memory the matching will use
+    SGBMParams current_params();  // the parameters of the sliders and of the engine
+    void set_roi(const cv::Rect &roi);  // send the region of interest (in pixels, empty for all) to the worker
+    QRect displayed_left_image();  // where the preview of the left picture is, in its label
 
     // functions to manage constraints on sliders
     void set_SADWindowSize();  // manage max value of SADWindowSize slider
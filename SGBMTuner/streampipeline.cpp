@@ -0,0 +1,281 @@
+#include "streampipeline.h"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <chrono>
+
+// a couple of frames between two stages are enough to absorb the jitter of their durations
+static const size_t queue_capacity = 2;
+
+StreamPipeline::StreamPipeline(QObject *parent) :
+    QObject(parent),
+    decoded(queue_capacity),
+    grayscale(queue_capacity),
+    matched(queue_capacity),
+    stopping(false),
+    running(false),
+    run_number(0),
+    dropped_frame_count(0),
+    display_pending(false),
+    frame_rate(0),
+    display_size(480, 360),
+    colormap(false),
+    stage_timer(0)
+{
+}
+
+StreamPipeline::~StreamPipeline()
+{
+    stop();
+}
+
+bool StreamPipeline::start(const QString &left, const QString &right)
+{
+    stop();
+    if (!source.open(left.toUtf8().constData(), right.toUtf8().constData()))
+        return false;
+
+    decoded.reset();
+    grayscale.reset();
+    matched.reset();
+    stopping = false;
+    dropped_frame_count = 0;
+    display_pending = false;
+    running = true;
+    run_number++;
+
+    decode_thread = std::thread(&StreamPipeline::decode, this);
+    gray_thread = std::thread(&StreamPipeline::convert_to_gray, this);
+    match_thread = std::thread(&StreamPipeline::match, this);
+    visualize_thread = std::thread(&StreamPipeline::visualize, this);
+    return true;
+}
+
+void StreamPipeline::stop()
+{
+    stopping = true;
+    decoded.close();
+    grayscale.close();
+    matched.close();
+
+    if (decode_thread.joinable())
+        decode_thread.join();
+    if (gray_thread.joinable())
+        gray_thread.join();
+    if (match_thread.joinable())
+        match_thread.join();
+    if (visualize_thread.joinable())
+        visualize_thread.join();
+
+    source.close();
+    running = false;
+}
+
+int StreamPipeline::run() const
+{
+    return run_number;
+}
+
+bool StreamPipeline::is_running() const
+{
+    return running;
+}
+
+void StreamPipeline::set_params(const SGBMParams &params)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->params = params;
+}
+
+void StreamPipeline::set_frame_rate(double fps)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    frame_rate = fps > 0 ? fps : 0;
+}
+
+double StreamPipeline::source_frame_rate() const
+{
+    return source.frame_rate();
+}
+
+void StreamPipeline::set_display_size(const QSize &size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    display_size = size;
+}
+
+void StreamPipeline::set_colormap(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    colormap = enabled;
+}
+
+void StreamPipeline::set_stage_timer(StageTimer *timer)
+{
+    stage_timer = timer;
+}
+
+int StreamPipeline::dropped_frames() const
+{
+    return dropped_frame_count;
+}
+
+void StreamPipeline::frame_displayed()
+{
+    display_pending = false;
+}
+
+// we read the frames, at the requested frame rate
+void StreamPipeline::decode()
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point next_frame = Clock::now();
+
+    for (int index = 0; !stopping; index++) {
+        Frame frame;
+        frame.index = index;
+        bool ok;
+        {
+            StageTimer::Scope scope(stage_timer, "stream decode");
+            ok = source.read(frame.left, frame.right);
+        }
+        if (!ok)
+            break;
+
+        double fps;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fps = frame_rate;
+        }
+
+        if (fps > 0) {
+            // like a camera, we never wait for the next stages
+            bool dropped;
+            if (!decoded.push_dropping_oldest(frame, dropped))
+                break;
+            if (dropped)
+                dropped_frame_count++;
+
+            next_frame += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+            Clock::time_point now = Clock::now();
+            if (next_frame > now)
+                std::this_thread::sleep_until(next_frame);
+            else
+                next_frame = now;  // we do not try to catch up after a slow decoding
+        } else {
+            if (!decoded.push(frame))
+                break;
+        }
+    }
+
+    decoded.close();
+}
+
+// the matchers work on gray images
+void StreamPipeline::convert_to_gray()
+{
+    Frame frame;
+    while (decoded.pop(frame)) {
+        {
+            StageTimer::Scope scope(stage_timer, "stream gray");
+            if (frame.left.channels() == 3)
+                cv::cvtColor(frame.left, frame.left, CV_BGR2GRAY);
+            if (frame.right.channels() == 3)
+                cv::cvtColor(frame.right, frame.right, CV_BGR2GRAY);
+        }
+        if (!grayscale.push(frame))
+            break;
+    }
+    grayscale.close();
+}
+
+// we match the frames with the latest parameters
+// the matcher (or the engine) is created once, and only its parameters are updated
+void StreamPipeline::match()
+{
+    Frame frame;
+    SGBMParams failed_params;  // the parameters of the last failure, while they still fail
+    bool failed = false;
+    while (grayscale.pop(frame)) {
+        SGBMParams frame_params;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            frame_params = params;
+        }
+
+        try {
+            StageTimer::Scope scope(stage_timer, "stream match");
+            if (frame_params.engine == SGBMParams::ENGINE_SGM) {
+                engine.compute(frame_params, frame.left, frame.right, frame.disparity);
+            } else {
+                if (matcher.empty())
+                    matcher = frame_params.create_matcher();
+                else
+                    frame_params.apply_to(matcher);
+                matcher->compute(frame.left, frame.right, frame.disparity);
+            }
+        } catch (const cv::Exception &e) {
+            // with parameters refused by OpenCV, all the frames fail the same way,
+            // so we only report it again once the parameters change
+            if (!failed || frame_params != failed_params)
+                emit compute_failed(QString::fromStdString(e.what()));
+            failed_params = frame_params;
+            failed = true;
+            continue;
+        }
+        failed = false;
+
+        if (!matched.push(frame))
+            break;
+    }
+    matched.close();
+}
+
+// we convert the frames and their depth maps into images the GUI can display
+void StreamPipeline::visualize()
+{
+    QVector<QRgb> gray_table(256);
+    for (int i = 0; i < 256; i++)
+        gray_table[i] = qRgb(i, i, i);
+
+    Frame frame;
+    cv::Mat resized_left;
+    QImage left_view;
+    while (matched.pop(frame)) {
+        // the GUI is still busy with the previous frame
+        if (display_pending) {
+            dropped_frame_count++;
+            continue;
+        }
+
+        QSize size;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size = display_size;
+            disparity_view.set_colormap(colormap);
+        }
+        size = size.boundedTo(QSize(frame.left.cols, frame.left.rows));
+
+        QImage depth_map;
+        {
+            StageTimer::Scope scope(stage_timer, "stream visualize");
+            depth_map = disparity_view.render(frame.disparity, size);
+            if (depth_map.isNull())
+                continue;
+
+            // the left frame is displayed at the size of the depth map
+            // (the image emitted last may still be used by the GUI, so a new one is created)
+            cv::resize(frame.left, resized_left, cv::Size(depth_map.width(), depth_map.height()), 0, 0, cv::INTER_AREA);
+            left_view = QImage(depth_map.size(), QImage::Format_Indexed8);
+            left_view.setColorTable(gray_table);
+            cv::Mat pixels(left_view.height(), left_view.width(), CV_8UC1, left_view.bits(), left_view.bytesPerLine());
+            resized_left.copyTo(pixels);
+        }
+
+        display_pending = true;
+        emit frame_ready(left_view, depth_map, frame.index);
+    }
+
+    if (!stopping)
+        emit finished(run_number);
+}
@@ -0,0 +1,129 @@
+#ifndef STREAMPIPELINE_H
+#define STREAMPIPELINE_H
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "boundedqueue.h"
+#include "disparityview.h"
+#include "sgbmparams.h"
+#include "sgmengine.h"
+#include "stagetimer.h"
+#include "stereosource.h"
+
+// computes the depth maps of a stereo video (or of two image sequences) frame after frame
+//
+// the frames go through a pipeline where each stage has its own thread:
+//     decode -> grayscale -> match -> visualize -> display (GUI thread)
+// so that the next frame is decoded while the current one is matched; the stages are
+// linked by short bounded queues, so a slow stage makes the previous ones wait instead
+// of piling frames up
+// at a given frame rate, the decoding is paced like a live camera, and when the
+// pipeline can not keep up, the frames are dropped (the oldest one first), as they
+// would be on the robot; at frame rate 0, the frames are processed as fast as
+// possible, and none is dropped (except for display, see frame_ready())
+class StreamPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StreamPipeline(QObject *parent = 0);
+    ~StreamPipeline();
+
+    // we open the streams, and start the threads (false if a stream can't be opened)
+    bool start(const QString &left, const QString &right);
+
+    // the number of the current (or last) run, incremented by each start()
+    int run() const;
+
+    // we stop the threads, and close the streams
+    void stop();
+    bool is_running() const;
+
+    // the parameters used for the next frames (can be changed while running)
+    void set_params(const SGBMParams &params);
+
+    // frames per second at which the frames are decoded, 0 for as fast as possible
+    void set_frame_rate(double fps);
+
+    // the frame rate of the opened video, 0 if unknown
+    double source_frame_rate() const;
+
+    // the maximum size of the images sent to the GUI
+    void set_display_size(const QSize &size);
+    void set_colormap(bool enabled);
+
+    // the timer receiving the duration of each stage
+    // (must be set while the pipeline is stopped, and outlive it)
+    void set_stage_timer(StageTimer *timer);
+
+    // the frames lost because a stage, or the display, was too slow
+    int dropped_frames() const;
+
+    // to call when a frame sent by frame_ready() has been displayed
+    void frame_displayed();
+
+signals:
+    // emitted (from the visualization thread) with a frame and its depth map
+    // a frame is only sent once the previous one has been displayed, the others are dropped
+    void frame_ready(const QImage &left, const QImage &depth_map, int frame_index);
+
+    // emitted (from the matching thread) when OpenCV refused to compute a map
+    // (once for each set of parameters refused, not for each frame)
+    void compute_failed(const QString &message);
+
+    // emitted when the end of the streams of this run is reached
+    // (a queued signal may arrive after another run was started, see run())
+    void finished(int run);
+
+private:
+    struct Frame {
+        Frame() : index(-1) {}
+        int index;
+        cv::Mat left;
+        cv::Mat right;
+        cv::Mat disparity;
+    };
+
+    StereoSource source;
+    std::thread decode_thread;
+    std::thread gray_thread;
+    std::thread match_thread;
+    std::thread visualize_thread;
+    BoundedQueue<Frame> decoded;
+    BoundedQueue<Frame> grayscale;
+    BoundedQueue<Frame> matched;
+    std::atomic<bool> stopping;
+    std::atomic<bool> running;
+    int run_number;  // only changed while the threads are stopped
+    std::atomic<int> dropped_frame_count;
+    std::atomic<bool> display_pending;
+
+    // shared with the GUI thread, protected by the mutex
+    mutable std::mutex mutex;
+    SGBMParams params;
+    double frame_rate;
+    QSize display_size;
+    bool colormap;
+
+    StageTimer *stage_timer;
+
+    // only used from their own thread
+    cv::Ptr<cv::StereoSGBM> matcher;
+    SGMEngine engine;
+    DisparityView disparity_view;
+
+    void decode();
+    void convert_to_gray();
+    void match();
+    void visualize();
+};
+
+#endif // STREAMPIPELINE_H
@@ -0,0 +1,32 @@
+#-------------------------------------------------
+#
+# Headless benchmark measuring the speed of the
+# block-matching algorithms across their parameters
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+CONFIG   += console
+CONFIG   -= app_bundle qt
+
+TARGET = StereoBench
+TEMPLATE = app
+
+
+SOURCES += main.cpp\
+        ../common/sgbmparams.cpp\
+        ../common/sgmcosts.cpp\
+        ../common/sgmengine.cpp\
+        ../common/sgmkernels.cpp
+
+HEADERS  += ../common/sgbmparams.h\
+        ../common/sgmcosts.h\
+        ../common/sgmengine.h\
+        ../common/sgmkernels.h
+
+INCLUDEPATH += ../common
+
+LIBS += -L/usr/local/lib -lopencv_core -lopencv_imgcodecs -lopencv_imgproc -lopencv_calib3d -lopencv_ximgproc
+
+QMAKE_CXXFLAGS += -std=c++11
@@ -0,0 +1,590 @@
+// StereoBench: measures the runtime of the block-matching (BM) and semi-global
+// block-matching (SGBM) algorithms of OpenCV, and of the SGM engine of the tuner, over
+// a grid of parameters and image sizes, without a GUI
+//
+// usage:
+//   StereoBench [options]
+//
+// options:
+//   --left FILE --right FILE   the stereo pair to match, resized to each size (default: a
+//                              synthetic textured pair, so that the results do not depend on data)
+//   --sizes LIST               image sizes (default: 320x240,640x480,1280x720,1920x1080)
+//   --matchers LIST            bm, sgbm, sgm (the SGM engine on the fastest instruction set
+//                              of the processor) or sgm:ISA (on a given one: scalar, sse4.1,
+//                              avx2, avx512 or neon) (default: bm,sgbm)
+//   --num-disparities LIST     default: 64,128,256
+//   --block-sizes LIST         default: 5,9,15
+//   --modes LIST               SGBM modes: 0 (SGBM), 1 (HH), 2 (3WAY), 3 (HH4) (default: 0,1,2)
+//                              (the SGM engine aggregates 8 paths in mode 1, 5 in the others)
+//   --costs LIST               matching costs of the SGM engine: census5x5, census7x9, rank, bt,
+//                              zsad (default: census5x5)
+//   --warmup N                 runs discarded before measuring (default 2)
+//   --repeat N                 measured runs of each configuration (default 10)
+//   --threads N                threads of OpenCV (default: OpenCV decides)
+//   --csv FILE                 write the results as CSV
+//   --json FILE                write the results as JSON, with the OpenCV version and the settings
+//
+// the lists are comma separated; a table with the median time per frame, the throughput
+// and the peak memory is printed on the standard output, with the ratio of bad pixels on the
+// synthetic pair (whose disparities are known)
+// the peak memory is the highest resident memory of the process while a configuration runs
+// (on Linux, the high-water mark is reset before each configuration; elsewhere, each
+// configuration runs in a child process of its own)
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "sgbmparams.h"
+#include "sgmcosts.h"
+#include "sgmengine.h"
+
+// one point of the grid
+struct Configuration {
+    std::string matcher;  // "bm", "sgbm" or "sgm:ISA"
+    cv::Size size;
+    int num_disparities;
+    int block_size;
+    int mode;             // -1 for BM
+    int cost;             // one of SGBMParams::COST_*, -1 for the matchers of OpenCV
+};
+
+// its measures
+struct Measure {
+    bool ok;
+    std::string error;
+    double median_ms;
+    double mean_ms;
+    double min_ms;
+    double mpix_per_s;
+    double peak_rss_mb;
+    double bad_ratio;     // -1 without the disparities of the images
+};
+
+typedef std::chrono::steady_clock Clock;
+
+// one run of a matcher: left, right, disparity
+typedef std::function<void(const cv::Mat &, const cv::Mat &, cv::Mat &)> ComputeFunction;
+
+static std::vector<std::string> split(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+static std::vector<int> split_ints(const std::string &list)
+{
+    std::vector<std::string> items = split(list);
+    std::vector<int> values;
+    for (size_t i = 0; i < items.size(); i++)
+        values.push_back(std::atoi(items[i].c_str()));
+    return values;
+}
+
+// "640x480"
+static std::vector<cv::Size> split_sizes(const std::string &list)
+{
+    std::vector<std::string> items = split(list);
+    std::vector<cv::Size> sizes;
+    for (size_t i = 0; i < items.size(); i++) {
+        int width = 0, height = 0;
+        if (std::sscanf(items[i].c_str(), "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+            sizes.push_back(cv::Size(width, height));
+        else
+            std::cerr << "invalid size " << items[i] << ", skipped" << std::endl;
+    }
+    return sizes;
+}
+
+static double max_rss_mb(const struct rusage &usage)
+{
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);  // in bytes on Mac OS
+#else
+    return usage.ru_maxrss / 1024.0;              // in kB on Linux
+#endif
+}
+
+// we bring the high-water mark of the resident memory down to the current resident memory,
+// so that the next peak_rss_mb() only sees what happens from now on
+// (false where it is not possible: only Linux can, since version 4.0)
+static bool reset_peak_rss()
+{
+#ifdef __linux__
+#ifdef __GLIBC__
+    // the memory freed by the previous configuration, still held by malloc
+    malloc_trim(0);
+#endif
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5" << std::flush;
+    return bool(clear_refs);
+#else
+    return false;
+#endif
+}
+
+// the highest resident memory of the process since the last reset_peak_rss(), in MB
+static double peak_rss_mb()
+{
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::atof(line.c_str() + 6) / 1024.0;  // in kB
+#endif
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return max_rss_mb(usage);
+}
+
+// the disparity of row y of the synthetic pair
+static double synthetic_disparity(int y, int height, int max_disparity)
+{
+    return double(max_disparity) * y / std::max(1, height - 1);
+}
+
+// a textured pair whose disparity grows from the top to the bottom of the image,
+// so that both matchers have something to find over the whole range
+static void synthetic_pair(const cv::Size &size, int max_disparity, cv::Mat &left, cv::Mat &right)
+{
+    cv::RNG rng(12345);
+    cv::Mat noise(size, CV_8UC1);
+    rng.fill(noise, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(noise, left, cv::Size(5, 5), 1.0);
+
+    cv::Mat map_x(size, CV_32FC1), map_y(size, CV_32FC1);
+    for (int y = 0; y < size.height; y++) {
+        float disparity = float(synthetic_disparity(y, size.height, max_disparity));
+        float *xs = map_x.ptr<float>(y);
+        float *ys = map_y.ptr<float>(y);
+        for (int x = 0; x < size.width; x++) {
+            xs[x] = x + disparity;
+            ys[x] = float(y);
+        }
+    }
+    cv::remap(left, right, map_x, map_y, cv::INTER_LINEAR, cv::BORDER_REFLECT);
+}
+
+// the ratio of the pixels of the synthetic pair whose disparity is missing or off by more
+// than one pixel (the columns on the left, which no matcher can match, are not counted)
+static double bad_pixel_ratio(const cv::Mat &disparity, int max_disparity, int num_disparities)
+{
+    int bad = 0, counted = 0;
+    for (int y = 0; y < disparity.rows; y++) {
+        double truth = synthetic_disparity(y, disparity.rows, max_disparity);
+        const short *row = disparity.ptr<short>(y);
+        for (int x = num_disparities; x < disparity.cols; x++, counted++)
+            if (row[x] < 0 || std::abs(row[x] / double(cv::StereoMatcher::DISP_SCALE) - truth) > 1)
+                bad++;
+    }
+    return counted > 0 ? double(bad) / counted : 0;
+}
+
+// the instruction set of an "sgm:ISA" matcher, false for the other matchers
+static bool sgm_isa(const std::string &matcher, SimdIsa &isa)
+{
+    if (matcher.compare(0, 4, "sgm:") != 0)
+        return false;
+    for (int i = SIMD_SCALAR; i <= SIMD_NEON; i++)
+        if (matcher.substr(4) == simd_isa_name(SimdIsa(i))) {
+            isa = SimdIsa(i);
+            return true;
+        }
+    return false;
+}
+
+static ComputeFunction create_matcher(const Configuration &configuration)
+{
+    if (configuration.matcher == "bm") {
+        cv::Ptr<cv::StereoMatcher> matcher = cv::StereoBM::create(configuration.num_disparities, configuration.block_size);
+        return [matcher](const cv::Mat &left, const cv::Mat &right, cv::Mat &disparity) {
+            matcher->compute(left, right, disparity);
+        };
+    }
+
+    // the penalties recommended by OpenCV, as in the tuner
+    SGBMParams params;
+    params.min_disparity = 0;
+    params.num_disparities = configuration.num_disparities;
+    params.block_size = configuration.block_size;
+    params.P1 = 8 * configuration.block_size * configuration.block_size;
+    params.P2 = 32 * configuration.block_size * configuration.block_size;
+    params.mode = configuration.mode;
+
+    SimdIsa isa;
+    if (!sgm_isa(configuration.matcher, isa)) {
+        cv::Ptr<cv::StereoMatcher> matcher = params.create_matcher();
+        return [matcher](const cv::Mat &left, const cv::Mat &right, cv::Mat &disparity) {
+            matcher->compute(left, right, disparity);
+        };
+    }
+
+    if (!simd_isa_supported(isa))
+        CV_Error(cv::Error::StsNotImplemented, std::string(simd_isa_name(isa)) + " is not supported by this processor");
+    std::shared_ptr<SGMEngine> engine(new SGMEngine());
+    engine->set_isa(isa);
+    params.engine = SGBMParams::ENGINE_SGM;
+    params.cost = configuration.cost;
+    return [engine, params](const cv::Mat &left, const cv::Mat &right, cv::Mat &disparity) {
+        engine->compute(params, left, right, disparity);
+    };
+}
+
+// max_disparity: the one of the synthetic pair, 0 for other images
+static Measure run(const Configuration &configuration, const cv::Mat &left, const cv::Mat &right,
+                   int warmup, int repeat, int max_disparity)
+{
+    Measure measure = { false, "", 0, 0, 0, 0, 0, -1 };
+    std::vector<double> times;
+    cv::Mat disparity;
+    try {
+        ComputeFunction compute = create_matcher(configuration);
+        for (int i = 0; i < warmup + repeat; i++) {
+            Clock::time_point start = Clock::now();
+            compute(left, right, disparity);
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            if (i >= warmup)
+                times.push_back(ms);
+        }
+    } catch (const cv::Exception &e) {
+        measure.error = e.what();
+        return measure;
+    }
+
+    std::sort(times.begin(), times.end());
+    double sum = 0;
+    for (size_t i = 0; i < times.size(); i++)
+        sum += times[i];
+
+    measure.ok = true;
+    measure.median_ms = times[times.size() / 2];
+    measure.mean_ms = sum / times.size();
+    measure.min_ms = times.front();
+    measure.mpix_per_s = configuration.size.area() / 1e6 / (measure.median_ms / 1000);
+    measure.peak_rss_mb = peak_rss_mb();
+    if (max_disparity > 0)
+        measure.bad_ratio = bad_pixel_ratio(disparity, max_disparity, configuration.num_disparities);
+    return measure;
+}
+
+// we run a configuration in a child process, so that the peak memory is its own
+// (the measures come back through a pipe, the peak memory from the resource usage of the child)
+static Measure run_in_child(const Configuration &configuration, const cv::Mat &left, const cv::Mat &right,
+                            int warmup, int repeat, int max_disparity)
+{
+    Measure measure = { false, "", 0, 0, 0, 0, 0, -1 };
+    int fds[2];
+    if (pipe(fds) != 0) {
+        measure.error = "can't create a pipe to the child process";
+        return measure;
+    }
+
+    std::fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        measure.error = "can't create a child process";
+        return measure;
+    }
+    if (child == 0) {
+        close(fds[0]);
+        Measure result = run(configuration, left, right, warmup, repeat, max_disparity);
+        std::ostringstream text;
+        text.precision(17);
+        text << result.ok << " " << result.median_ms << " " << result.mean_ms << " " << result.min_ms << " "
+             << result.mpix_per_s << " " << result.bad_ratio << " " << result.error;
+        std::string bytes = text.str();
+        for (size_t written = 0; written < bytes.size(); ) {
+            ssize_t count = write(fds[1], bytes.data() + written, bytes.size() - written);
+            if (count <= 0)
+                break;
+            written += size_t(count);
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    std::string bytes;
+    char buffer[4096];
+    for (ssize_t count; (count = read(fds[0], buffer, sizeof(buffer))) > 0; )
+        bytes.append(buffer, size_t(count));
+    close(fds[0]);
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(child, &status, 0, &usage) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        measure.error = "the child process failed";
+        return measure;
+    }
+
+    std::istringstream text(bytes);
+    text >> measure.ok >> measure.median_ms >> measure.mean_ms >> measure.min_ms
+         >> measure.mpix_per_s >> measure.bad_ratio;
+    if (!text) {
+        measure.ok = false;
+        measure.error = "the child process failed";
+        return measure;
+    }
+    text.get();  // the separator
+    measure.error.assign(std::istreambuf_iterator<char>(text), std::istreambuf_iterator<char>());
+    if (measure.ok)
+        measure.peak_rss_mb = max_rss_mb(usage);
+    return measure;
+}
+
+// the error messages of OpenCV span several lines, and may contain commas and quotes
+static std::string single_line(std::string text)
+{
+    for (size_t i = 0; i < text.size(); i++)
+        if (text[i] == ',' || text[i] == '\n' || text[i] == '\r' || text[i] == '"' || text[i] == '\\')
+            text[i] = ' ';
+    return text;
+}
+
+static void usage()
+{
+    std::cerr << "usage: StereoBench [--left FILE --right FILE] [--sizes WxH,...] [--matchers bm,sgbm,sgm,sgm:ISA]"
+              << " [--num-disparities N,...] [--block-sizes N,...] [--modes N,...] [--costs NAME,...]"
+              << " [--warmup N] [--repeat N] [--threads N] [--csv FILE] [--json FILE]" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string left_file, right_file, csv_file, json_file;
+    std::vector<cv::Size> sizes = split_sizes("320x240,640x480,1280x720,1920x1080");
+    std::vector<std::string> matchers = split("bm,sgbm");
+    std::vector<int> num_disparities = split_ints("64,128,256");
+    std::vector<int> block_sizes = split_ints("5,9,15");
+    std::vector<int> modes = split_ints("0,1,2");
+    std::vector<std::string> cost_names = split("census5x5");
+    int warmup = 2, repeat = 10, threads = -1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--left" && has_value)
+            left_file = argv[++i];
+        else if (arg == "--right" && has_value)
+            right_file = argv[++i];
+        else if (arg == "--sizes" && has_value)
+            sizes = split_sizes(argv[++i]);
+        else if (arg == "--matchers" && has_value)
+            matchers = split(argv[++i]);
+        else if (arg == "--num-disparities" && has_value)
+            num_disparities = split_ints(argv[++i]);
+        else if (arg == "--block-sizes" && has_value)
+            block_sizes = split_ints(argv[++i]);
+        else if (arg == "--modes" && has_value)
+            modes = split_ints(argv[++i]);
+        else if (arg == "--costs" && has_value)
+            cost_names = split(argv[++i]);
+        else if (arg == "--warmup" && has_value)
+            warmup = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--repeat" && has_value)
+            repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--threads" && has_value)
+            threads = std::atoi(argv[++i]);
+        else if (arg == "--csv" && has_value)
+            csv_file = argv[++i];
+        else if (arg == "--json" && has_value)
+            json_file = argv[++i];
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    if (left_file.empty() != right_file.empty()) {
+        usage();
+        return 2;
+    }
+
+    cv::Mat left_source, right_source;
+    if (!left_file.empty()) {
+        left_source = cv::imread(left_file, cv::IMREAD_GRAYSCALE);
+        right_source = cv::imread(right_file, cv::IMREAD_GRAYSCALE);
+        if (left_source.empty() || right_source.empty()) {
+            std::cerr << "can't read the images" << std::endl;
+            return 1;
+        }
+    }
+
+    if (threads >= 0)
+        cv::setNumThreads(threads);
+
+    // the smallest images first
+    std::sort(sizes.begin(), sizes.end(), [](const cv::Size &a, const cv::Size &b) { return a.area() < b.area(); });
+
+    // "sgm" is the engine on the fastest instruction set, named in the results
+    for (size_t m = 0; m < matchers.size(); m++)
+        if (matchers[m] == "sgm")
+            matchers[m] = std::string("sgm:") + simd_isa_name(best_simd_isa());
+
+    std::vector<int> costs;
+    for (size_t c = 0; c < cost_names.size(); c++) {
+        costs.push_back(MatchingCost::from_name(cost_names[c]));
+        if (costs.back() < 0) {
+            std::cerr << "unknown cost " << cost_names[c] << std::endl;
+            return 2;
+        }
+    }
+
+    // the grid: the mode only applies to SGBM and to the SGM engine, the cost to the SGM engine
+    std::vector<Configuration> configurations;
+    for (size_t s = 0; s < sizes.size(); s++)
+        for (size_t m = 0; m < matchers.size(); m++)
+            for (size_t d = 0; d < num_disparities.size(); d++)
+                for (size_t b = 0; b < block_sizes.size(); b++) {
+                    Configuration configuration = { matchers[m], sizes[s], num_disparities[d], block_sizes[b], -1, -1 };
+                    SimdIsa isa;
+                    if (matchers[m] == "bm") {
+                        configurations.push_back(configuration);
+                    } else if (matchers[m] == "sgbm") {
+                        for (size_t o = 0; o < modes.size(); o++) {
+                            configuration.mode = modes[o];
+                            configurations.push_back(configuration);
+                        }
+                    } else if (sgm_isa(matchers[m], isa)) {
+                        for (size_t o = 0; o < modes.size(); o++)
+                            for (size_t c = 0; c < costs.size(); c++) {
+                                configuration.mode = modes[o];
+                                configuration.cost = costs[c];
+                                configurations.push_back(configuration);
+                            }
+                    } else {
+                        std::cerr << "unknown matcher " << matchers[m] << std::endl;
+                        return 2;
+                    }
+                }
+
+    std::printf("%-10s %-10s %5s %5s %4s %-9s %10s %10s %10s %9s %6s\n",
+                "algo", "size", "ndisp", "block", "mode", "cost", "ms/frame", "min ms", "Mpix/s", "peak MB", "bad %");
+
+    const int synthetic_max_disparity = 64;
+    std::vector<Measure> measures;
+    cv::Size current_size;
+    cv::Mat left, right;
+    for (size_t i = 0; i < configurations.size(); i++) {
+        const Configuration &configuration = configurations[i];
+        if (configuration.size != current_size) {
+            current_size = configuration.size;
+            if (left_source.empty()) {
+                synthetic_pair(current_size, synthetic_max_disparity, left, right);
+            } else {
+                cv::resize(left_source, left, current_size, 0, 0, cv::INTER_AREA);
+                cv::resize(right_source, right, current_size, 0, 0, cv::INTER_AREA);
+            }
+        }
+
+        int max_disparity = left_source.empty() ? synthetic_max_disparity : 0;
+        Measure measure = reset_peak_rss() ?
+                          run(configuration, left, right, warmup, repeat, max_disparity) :
+                          run_in_child(configuration, left, right, warmup, repeat, max_disparity);
+        measures.push_back(measure);
+
+        char size[32], bad[16];
+        std::snprintf(size, sizeof(size), "%dx%d", configuration.size.width, configuration.size.height);
+        if (measure.bad_ratio >= 0)
+            std::snprintf(bad, sizeof(bad), "%6.2f", measure.bad_ratio * 100);
+        else
+            std::snprintf(bad, sizeof(bad), "%6s", "-");
+        const char *cost = configuration.cost >= 0 ? MatchingCost::name(configuration.cost) : "-";
+        if (measure.ok)
+            std::printf("%-10s %-10s %5d %5d %4d %-9s %10.2f %10.2f %10.2f %9.1f %s\n",
+                        configuration.matcher.c_str(), size, configuration.num_disparities,
+                        configuration.block_size, configuration.mode, cost,
+                        measure.median_ms, measure.min_ms, measure.mpix_per_s, measure.peak_rss_mb, bad);
+        else
+            std::printf("%-10s %-10s %5d %5d %4d %-9s   refused by the matcher\n",
+                        configuration.matcher.c_str(), size, configuration.num_disparities,
+                        configuration.block_size, configuration.mode, cost);
+        std::fflush(stdout);
+    }
+
+    if (!csv_file.empty()) {
+        std::ofstream csv(csv_file.c_str());
+        csv << "matcher,width,height,num_disparities,block_size,mode,cost,median_ms,mean_ms,min_ms,mpix_per_s,peak_rss_mb,bad_ratio,status" << std::endl;
+        for (size_t i = 0; i < configurations.size(); i++) {
+            const Configuration &c = configurations[i];
+            const Measure &m = measures[i];
+            csv << c.matcher << "," << c.size.width << "," << c.size.height << ","
+                << c.num_disparities << "," << c.block_size << "," << c.mode << ","
+                << (c.cost >= 0 ? MatchingCost::name(c.cost) : "") << ","
+                << m.median_ms << "," << m.mean_ms << "," << m.min_ms << ","
+                << m.mpix_per_s << "," << m.peak_rss_mb << ","
+                << (m.bad_ratio >= 0 ? std::to_string(m.bad_ratio) : std::string()) << ","
+                << (m.ok ? "ok" : single_line(m.error)) << std::endl;
+        }
+        if (!csv) {
+            std::cerr << "can't write " << csv_file << std::endl;
+            return 1;
+        }
+    }
+
+    if (!json_file.empty()) {
+        std::ofstream json(json_file.c_str());
+        json << "{\n"
+             << "  \"opencv_version\": \"" << CV_VERSION << "\",\n"
+             << "  \"threads\": " << cv::getNumThreads() << ",\n"
+             << "  \"warmup\": " << warmup << ",\n"
+             << "  \"repeat\": " << repeat << ",\n"
+             << "  \"images\": \"" << (left_file.empty() ? "synthetic" : single_line(left_file)) << "\",\n"
+             << "  \"results\": [";
+        for (size_t i = 0; i < configurations.size(); i++) {
+            const Configuration &c = configurations[i];
+            const Measure &m = measures[i];
+            json << (i > 0 ? "," : "") << "\n    {"
+                 << "\"matcher\": \"" << c.matcher << "\", \"width\": " << c.size.width
+                 << ", \"height\": " << c.size.height << ", \"num_disparities\": " << c.num_disparities
+                 << ", \"block_size\": " << c.block_size << ", \"mode\": " << c.mode;
+            if (c.cost >= 0)
+                json << ", \"cost\": \"" << MatchingCost::name(c.cost) << "\"";
+            if (m.ok && m.bad_ratio >= 0)
+                json << ", \"bad_ratio\": " << m.bad_ratio;
+            if (m.ok)
+                json << ", \"median_ms\": " << m.median_ms << ", \"mean_ms\": " << m.mean_ms
+                     << ", \"min_ms\": " << m.min_ms << ", \"mpix_per_s\": " << m.mpix_per_s
+                     << ", \"peak_rss_mb\": " << m.peak_rss_mb << ", \"status\": \"ok\"}";
+            else
+                json << ", \"status\": \"" << single_line(m.error) << "\"}";
+        }
+        json << "\n  ]\n}" << std::endl;
+        if (!json) {
+            std::cerr << "can't write " << json_file << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
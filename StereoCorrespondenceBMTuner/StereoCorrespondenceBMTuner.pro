@@ -13,9 +13,23 @@ TEMPLATE = app
 
 
 SOURCES += main.cpp\
-        mainwindow.cpp
-
-HEADERS  += mainwindow.h
+        mainwindow.cpp\
+        ../common/disparityview.cpp\
+        ../common/imageloader.cpp\
+        ../common/mappedfile.cpp\
+        ../common/previewimage.cpp\
+        ../common/rawstereo.cpp\
+        ../common/stagetimer.cpp
+
+HEADERS  += mainwindow.h\
+        ../common/disparityview.h\
+        ../common/imageloader.h\
+        ../common/mappedfile.h\
+        ../common/previewimage.h\
+        ../common/rawstereo.h\
+        ../common/stagetimer.h
+
+INCLUDEPATH += ../common
 
 FORMS    += mainwindow.ui
 
@@ -26,3 +40,5 @@ QT_CONFIG -= no-pkg-config
 # we add the package opencv to pkg-config
 CONFIG += link_pkgconfig
 PKGCONFIG += opencv
+
+QMAKE_CXXFLAGS += -std=c++11
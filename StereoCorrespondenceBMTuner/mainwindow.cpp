@@ -1,6 +1,9 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+#include <QFileInfo>
+#include <QStatusBar>
+
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow)
@@ -32,10 +35,21 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->horizontalSlider_speckle_window_size->setValue(bmState.state->speckleWindowSize);
     ui->horizontalSlider_speckle_range->setValue(bmState.state->speckleRange);
     ui->horizontalSlider_disp_12_max_diff->setValue(bmState.state->disp12MaxDiff);
+
+    // the pictures are decoded in the background
+    image_loader = new ImageLoader(this);
+    image_loader->set_stage_timer(&stage_timer);
+    connect(image_loader, SIGNAL(loaded(LoadedImage)), this, SLOT(display_loaded_image(LoadedImage)), Qt::QueuedConnection);
+    image_loader->start();
+
+    timing_label = new QLabel(this);
+    timing_label->setToolTip("median / 95th percentile of the last durations of each stage");
+    statusBar()->addPermanentWidget(timing_label);
 }
 
 MainWindow::~MainWindow()
 {
+    image_loader->stop();
     delete ui;
 }
 
@@ -45,35 +59,18 @@ void MainWindow::on_pushButton_left_clicked()
 {
     // we prompt the user with a file dialog,
     // to select the picture file from the left camera
-    QString filename = QFileDialog::getOpenFileName(this, "Select left picture file", QDir::homePath(), NULL);
+    QString filename = QFileDialog::getOpenFileName(this, "Select left picture file (or raw stereo capture)", QDir::homePath(), NULL);
     if (filename.isNull() || filename.isEmpty())
         return;
 
-    ///// Qt display stuff
-
-    // we load the picture from the file, to display it in a QLabel in the GUI
-    QImage left_picture;
-    left_picture.load(filename);
-
-    // some computation to resize the image if it is too big to fit in the GUI
-    QPixmap left_pixmap = QPixmap::fromImage(left_picture);
-    int max_width  = std::min(ui->label_image_left->maximumWidth(), left_picture.width());
-    int max_height = std::min(ui->label_image_left->maximumHeight(), left_picture.height());
-    ui->label_image_left->setPixmap(left_pixmap.scaled(max_width, max_height, Qt::KeepAspectRatio));
-
-    set_SADWindowSize();  // the SAD window size parameter depends on the size of the image
-
-    ///// OpenCV disparity map computation
-
-    // we convert filename from QString to std::string (needed by OpenCV)
-    std::string filename_s = filename.toUtf8().constData();
-
-    // we load the picture in the OpenCV Mat format, to compute depth map
-    cv::Mat mat = cv::imread(filename_s, CV_LOAD_IMAGE_COLOR);
-    cv::cvtColor(mat, mat, CV_BGR2GRAY);  // we convert to gray, needed to compute depth map
-    this->left_image = mat;
+    if (RawStereoFile::is_raw_stereo(filename.toUtf8().constData())) {
+        load_raw_capture(filename);
+        return;
+    }
 
-    compute_depth_map();
+    // the picture is decoded in the background, and sent back to display_loaded_image()
+    image_loader->load(filename, LEFT_VIEW, ui->label_image_left->maximumSize());
+    ui->label_image_left->setText("loading " + QFileInfo(filename).fileName() + "...");
 }
 
 // method called when the button to change the right image is clicked
@@ -82,34 +79,67 @@ void MainWindow::on_pushButton_right_clicked()
 {
     // we prompt the user with a file dialog,
     // to select the picture file from the left camera
-    QString filename = QFileDialog::getOpenFileName(this, "Select right picture file", QDir::homePath(), NULL);
+    QString filename = QFileDialog::getOpenFileName(this, "Select right picture file (or raw stereo capture)", QDir::homePath(), NULL);
     if (filename.isNull() || filename.isEmpty())
         return;
 
-    ///// Qt display stuff
+    if (RawStereoFile::is_raw_stereo(filename.toUtf8().constData())) {
+        load_raw_capture(filename);
+        return;
+    }
 
-    // we load the picture from the file, to display it in a QLabel in the GUI
-    QImage right_picture;
-    right_picture.load(filename);
+    // the picture is decoded in the background, and sent back to display_loaded_image()
+    image_loader->load(filename, RIGHT_VIEW, ui->label_image_right->maximumSize());
+    ui->label_image_right->setText("loading " + QFileInfo(filename).fileName() + "...");
+}
 
-    // some computation to resize the image if it is too big to fit in the GUI
-    QPixmap right_pixmap = QPixmap::fromImage(right_picture);
-    int max_width  = std::min(ui->label_image_right->maximumWidth(), right_picture.width());
-    int max_height = std::min(ui->label_image_right->maximumHeight(), right_picture.height());
-    ui->label_image_right->setPixmap(right_pixmap.scaled(max_width, max_height, Qt::KeepAspectRatio));
+// called (through a queued connection) when the loader has decoded a picture
+// the preview and the matched picture come from a single decode
+void MainWindow::display_loaded_image(const LoadedImage &loaded)
+{
+    QLabel *label = loaded.target == LEFT_VIEW ? ui->label_image_left : ui->label_image_right;
+    if (!loaded.error.isEmpty()) {
+        label->setText(loaded.error);
+        return;
+    }
+
+    label->setPixmap(QPixmap::fromImage(loaded.preview));
+    if (loaded.target == LEFT_VIEW)
+        left_image = loaded.image;
+    else
+        right_image = loaded.image;
 
     set_SADWindowSize();  // the SAD window size parameter depends on the size of the image
+    compute_depth_map();
+}
 
-    ///// OpenCV disparity map computation
+// we load both views from the first frame of a raw capture
+// the frames are matched straight from the memory mapping, so nothing is decoded
+void MainWindow::load_raw_capture(const QString &filename)
+{
+    RawStereoFile capture;
+    cv::Mat left, right;
+    {
+        StageTimer::Scope scope(stage_timer, "decode");
+        if (!capture.open(filename.toUtf8().constData()) || !capture.frame(0, left, right)) {
+            statusBar()->showMessage("Can't read the raw stereo capture " + filename);
+            return;
+        }
+    }
+    statusBar()->showMessage(QString("frame 1 of %1").arg(capture.frame_count()));
 
-    // we convert filename from QString to std::string (needed by OpenCV)
-    std::string filename_s = filename.toUtf8().constData();
+    // the frames keep the capture mapped (see RawStereoFile::frame()), so it is unmapped
+    // once both views are replaced
+    left_image = left;
+    right_image = right;
 
-    // we load the picture in the OpenCV Mat format, to compute depth map
-    cv::Mat mat = cv::imread(filename_s, CV_LOAD_IMAGE_COLOR);
-    cv::cvtColor(mat, mat, CV_BGR2GRAY);  // we convert to gray, needed to compute depth map
-    this->right_image = mat;
+    {
+        StageTimer::Scope scope(stage_timer, "preview");
+        ui->label_image_left->setPixmap(QPixmap::fromImage(preview_image(left_image, ui->label_image_left->maximumSize())));
+        ui->label_image_right->setPixmap(QPixmap::fromImage(preview_image(right_image, ui->label_image_right->maximumSize())));
+    }
 
+    set_SADWindowSize();
     compute_depth_map();
 }
 
@@ -126,36 +156,36 @@ void MainWindow::compute_depth_map() {
     }
 
     // we compute the depth map
-    cv::Mat disparity_16S;  // 16 bits, signed
-    bmState(left_image, right_image, disparity_16S);
+    {
+        StageTimer::Scope scope(stage_timer, "match");
+        bmState(left_image, right_image, disparity_16S);
+    }
 
     // we convert the depth map to a QPixmap, to display it in the QUI
-    // first, we need to convert the disparity map to a more regular grayscale format
-    // then, we convert to RGB, and finally, we can convert to a QImage and then a QPixmap
-
-    // we normalize the values, so that they all fit in the range [0, 255]
-    cv::normalize(disparity_16S, disparity_16S, 0, 255, CV_MINMAX);
-
-    // we convert the values from 16 bits signed to 8 bits unsigned
-    cv::Mat disp(disparity_16S.rows, disparity_16S.cols, CV_8UC1);
-    for (int i=0; i<disparity_16S.rows; i++)
-        for (int j=0; j<disparity_16S.cols; j++)
-            disp.at<unsigned char>(i,j) = (unsigned char)disparity_16S.at<short>(i,j);
-
-    // we convert from gray to color
-    cv::Mat disp_color;
-    cv::cvtColor(disp, disp_color, CV_GRAY2RGB);
+    // the disparity view scales the values to the range [0, 255] and resizes the map
+    // to fit in the GUI in a single pass, reusing its buffers between calls
+    QSize max_size = ui->label_depth_map->maximumSize().boundedTo(QSize(disparity_16S.cols, disparity_16S.rows));
+    QImage disparity_image = disparity_view.render(disparity_16S, max_size, &stage_timer);
+    {
+        StageTimer::Scope scope(stage_timer, "pixmap");
+        ui->label_depth_map->setPixmap(QPixmap::fromImage(disparity_image));
+    }
 
-    // we finally can convert the image to a QPixmap and display it
-    QImage disparity_image = QImage((unsigned char*) disp_color.data, disp_color.cols, disp_color.rows, QImage::Format_RGB888);
-    QPixmap disparity_pixmap = QPixmap::fromImage(disparity_image);
+    timing_label->setText(QString::fromStdString(stage_timer.summary()));
+}
 
-    // some computation to resize the image if it is too big to fit in the GUI
-    int max_width  = std::min(ui->label_depth_map->maximumWidth(),  disparity_image.width());
-    int max_height = std::min(ui->label_depth_map->maximumHeight(), disparity_image.height());
-    ui->label_depth_map->setPixmap(disparity_pixmap.scaled(max_width, max_height, Qt::KeepAspectRatio));
+// we export the percentiles of the stage durations, as JSON or CSV depending on the extension
+void MainWindow::on_pushButton_export_timings_clicked()
+{
+    QString filename = QFileDialog::getSaveFileName(this, "Export timings", QDir::homePath(), "Timings (*.json *.csv)");
+    if (filename.isNull() || filename.isEmpty())
+        return;
 
-    ui->label_depth_map->setPixmap(disparity_pixmap);
+    std::string filename_s = filename.toUtf8().constData();
+    bool written = filename.endsWith(".json", Qt::CaseInsensitive) ? stage_timer.export_json(filename_s)
+                                                                   : stage_timer.export_csv(filename_s);
+    if (!written)
+        statusBar()->showMessage("Can't write " + filename);
 }
 
 
@@ -9,6 +9,13 @@
 
 #include <QMainWindow>
 #include <QFileDialog>
+#include <QLabel>
+
+#include "disparityview.h"
+#include "imageloader.h"
+#include "previewimage.h"
+#include "rawstereo.h"
+#include "stagetimer.h"
 
 namespace Ui {
 class MainWindow;
@@ -27,6 +34,11 @@ private slots:
 
     void on_pushButton_right_clicked();
 
+    // called (through a queued connection) when the loader has decoded a picture
+    void display_loaded_image(const LoadedImage &loaded);
+
+    void on_pushButton_export_timings_clicked();
+
     void on_horizontalSlider_num_of_disparity_sliderMoved(int position);
 
     void on_horizontalSlider_num_of_disparity_valueChanged(int value);
@@ -53,6 +65,15 @@ private:
     // the UI object, to access the UI elements created with Qt Designer
     Ui::MainWindow *ui;
 
+    // the views, as targets of the image loader
+    enum View {
+        LEFT_VIEW,
+        RIGHT_VIEW
+    };
+
+    // decodes the pictures in the background
+    ImageLoader *image_loader;
+
     // the left and right pictures, converted to OpenCV Mat format
     cv::Mat left_image;
     cv::Mat right_image;
@@ -60,7 +81,17 @@ private:
     // the object that holds the parameters for the block-matching algorithm
     cv::StereoBM bmState;
 
+    // the depth map, and the object that converts it for display
+    cv::Mat disparity_16S;  // 16 bits, signed
+    DisparityView disparity_view;
+
+    // the duration of each stage, from the decoding of the images to the display of the map,
+    // and the label in the status bar showing its percentiles
+    StageTimer stage_timer;
+    QLabel *timing_label;
+
     void compute_depth_map();  // compute depth map with OpenCV
+    void load_raw_capture(const QString &filename);  // load both pictures from a raw capture
 
     // functions to manage constraints on sliders
     void set_SADWindowSize();  // manage max value of SADWindowSize slider
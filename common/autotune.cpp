@@ -0,0 +1,370 @@
+#include "autotune.h"
+
+#include "opencv2/core/core.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+
+#include "sgmengine.h"
+
+// the names of the parameters, in the order of the CSV columns
+static const char *param_names[] = {
+    "min_disparity", "num_disparities", "block_size", "P1", "P2", "disp12_max_diff",
+    "pre_filter_cap", "uniqueness_ratio", "speckle_window_size", "speckle_range", "mode",
+    "engine", "cost"
+};
+static const int param_count = sizeof(param_names) / sizeof(param_names[0]);
+
+static int *param_field(SGBMParams &params, const std::string &name)
+{
+    if (name == "min_disparity") return &params.min_disparity;
+    if (name == "num_disparities") return &params.num_disparities;
+    if (name == "block_size") return &params.block_size;
+    if (name == "P1") return &params.P1;
+    if (name == "P2") return &params.P2;
+    if (name == "disp12_max_diff") return &params.disp12_max_diff;
+    if (name == "pre_filter_cap") return &params.pre_filter_cap;
+    if (name == "uniqueness_ratio") return &params.uniqueness_ratio;
+    if (name == "speckle_window_size") return &params.speckle_window_size;
+    if (name == "speckle_range") return &params.speckle_range;
+    if (name == "mode") return &params.mode;
+    if (name == "engine") return &params.engine;
+    if (name == "cost") return &params.cost;
+    return 0;
+}
+
+/////////////////// Search space //////////////////////
+
+SearchSpace SearchSpace::default_space()
+{
+    SearchSpace space;
+    space.ranges["num_disparities"] = ParamRange(16, 256, 16);
+    space.ranges["block_size"] = ParamRange(3, 11, 2);
+    space.ranges["P1"] = ParamRange(100, 1500, 200);
+    space.ranges["P2"] = ParamRange(400, 6000, 400);
+    space.ranges["uniqueness_ratio"] = ParamRange(0, 20, 5);
+    space.ranges["speckle_window_size"] = ParamRange(0, 200, 50);
+    space.ranges["speckle_range"] = ParamRange(1, 4, 1);
+    space.ranges["mode"] = ParamRange(0, 3, 1);
+    return space;
+}
+
+bool SearchSpace::load(const std::string &filename, SearchSpace &space)
+{
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    if (!fs.isOpened())
+        return false;
+
+    SearchSpace loaded;
+    cv::FileNode root = fs.root();
+    for (cv::FileNodeIterator it = root.begin(); it != root.end(); ++it) {
+        cv::FileNode node = *it;
+        SGBMParams dummy;
+        std::vector<int> values;
+        node >> values;
+        if (!param_field(dummy, node.name()) || values.size() != 3)
+            return false;
+        loaded.ranges[node.name()] = ParamRange(values[0], values[1], std::max(1, values[2]));
+    }
+
+    space = loaded;
+    return true;
+}
+
+void SearchSpace::set(SGBMParams &params, const std::string &name, int value)
+{
+    int *field = param_field(params, name);
+    if (field)
+        *field = value;
+}
+
+int SearchSpace::get(const SGBMParams &params, const std::string &name)
+{
+    int *field = param_field(const_cast<SGBMParams &>(params), name);
+    return field ? *field : 0;
+}
+
+void SearchSpace::constrain(SGBMParams &params)
+{
+    // the same constraints as the sliders of the tuner
+    params.block_size = std::max(1, params.block_size);
+    if ((params.block_size % 2) == 0)
+        params.block_size -= 1;
+    params.block_size = std::max(1, params.block_size);
+
+    params.num_disparities = std::max(16, params.num_disparities - params.num_disparities % 16);
+    params.pre_filter_cap = std::min(63, std::max(1, params.pre_filter_cap));
+    params.uniqueness_ratio = std::max(0, params.uniqueness_ratio);
+    params.mode = std::min(3, std::max(0, params.mode));
+
+    // the cost only exists in the SGM engine: with cv::StereoSGBM, all its values are
+    // the same candidate
+    params.engine = params.engine == SGBMParams::ENGINE_SGM ? SGBMParams::ENGINE_SGM : SGBMParams::ENGINE_OPENCV;
+    params.cost = std::min(int(SGBMParams::COST_COUNT) - 1, std::max(0, params.cost));
+    if (params.engine == SGBMParams::ENGINE_OPENCV)
+        params.cost = SGBMParams::COST_CENSUS_5X5;
+
+    params.P1 = std::max(0, params.P1);
+    if (params.P2 <= params.P1)
+        params.P2 = params.P1 + 1;
+}
+
+/////////////////// Evaluation //////////////////////
+
+// we count the pixels with a ground truth, and the bad ones among them
+static void count_bad_pixels(const cv::Mat &disparity_16S, int min_disparity, const cv::Mat &ground_truth,
+                             double threshold, long &bad, long &total)
+{
+    cv::Mat disparity;
+    disparity_16S.convertTo(disparity, CV_32F, 1.0 / 16);
+
+    cv::Mat error;
+    cv::absdiff(disparity, ground_truth, error);
+
+    cv::Mat known = cv::abs(ground_truth) < std::numeric_limits<float>::max();  // false for inf and nan
+    cv::Mat invalid = disparity_16S < min_disparity * 16;
+    cv::Mat wrong = ((error > threshold) | invalid) & known;
+
+    bad += cv::countNonZero(wrong);
+    total += cv::countNonZero(known);
+}
+
+double bad_pixel_rate(const cv::Mat &disparity_16S, int min_disparity, const cv::Mat &ground_truth, double threshold)
+{
+    long bad = 0, total = 0;
+    count_bad_pixels(disparity_16S, min_disparity, ground_truth, threshold, bad, total);
+    return total > 0 ? double(bad) / total : 0.0;
+}
+
+AutoTuner::AutoTuner(const std::vector<StereoSample> &samples, ThreadPool &pool, double bad_threshold) :
+    samples(samples),
+    pool(pool),
+    bad_threshold(bad_threshold)
+{
+}
+
+std::string AutoTuner::key(const SGBMParams &params)
+{
+    std::ostringstream stream;
+    for (int i = 0; i < param_count; i++)
+        stream << SearchSpace::get(params, param_names[i]) << " ";
+    return stream.str();
+}
+
+Candidate AutoTuner::evaluate_one(const SGBMParams &params)
+{
+    Candidate candidate;
+    candidate.params = params;
+    candidate.valid = true;
+    candidate.pareto = false;
+
+    long bad = 0, total = 0;
+    double runtime_ms = 0;
+    try {
+        cv::Ptr<cv::StereoSGBM> matcher = params.create_matcher();
+        SGMEngine engine;
+        for (size_t i = 0; i < samples.size(); i++) {
+            cv::Mat disparity;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if (params.engine == SGBMParams::ENGINE_SGM)
+                engine.compute(params, samples[i].left, samples[i].right, disparity);
+            else
+                matcher->compute(samples[i].left, samples[i].right, disparity);
+            runtime_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            count_bad_pixels(disparity, params.min_disparity, samples[i].ground_truth, bad_threshold, bad, total);
+        }
+    } catch (const cv::Exception &) {
+        candidate.valid = false;
+    }
+
+    candidate.bad_pixel_rate = (candidate.valid && total > 0) ? double(bad) / total : 1.0;
+    candidate.runtime_ms = candidate.valid ? runtime_ms / std::max<size_t>(1, samples.size())
+                                           : std::numeric_limits<double>::infinity();
+    return candidate;
+}
+
+std::vector<Candidate> AutoTuner::evaluate(const std::vector<SGBMParams> &params)
+{
+    // the parameters not evaluated yet (each one once)
+    std::vector<SGBMParams> todo;
+    std::map<std::string, bool> queued;
+    for (size_t i = 0; i < params.size(); i++) {
+        std::string k = key(params[i]);
+        if (!evaluated.count(k) && !queued.count(k)) {
+            queued[k] = true;
+            todo.push_back(params[i]);
+        }
+    }
+
+    std::vector<Candidate> results(todo.size());
+    pool.parallel_for(int(todo.size()), [&](int i) {
+        results[i] = evaluate_one(todo[i]);
+    });
+    for (size_t i = 0; i < todo.size(); i++)
+        evaluated[key(todo[i])] = results[i];
+
+    std::vector<Candidate> candidates;
+    for (size_t i = 0; i < params.size(); i++)
+        candidates.push_back(evaluated[key(params[i])]);
+    return candidates;
+}
+
+/////////////////// Search strategies //////////////////////
+
+// we keep one copy of each candidate
+static std::vector<Candidate> unique_candidates(const std::vector<Candidate> &candidates)
+{
+    std::vector<Candidate> unique;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        bool found = false;
+        for (size_t j = 0; j < unique.size() && !found; j++)
+            found = unique[j].params.same_matching(candidates[i].params);
+        if (!found)
+            unique.push_back(candidates[i]);
+    }
+    return unique;
+}
+
+std::vector<Candidate> AutoTuner::grid_search(const SGBMParams &base, const SearchSpace &space, int max_candidates)
+{
+    std::vector<std::string> names;
+    std::vector<ParamRange> ranges;
+    double total = 1;
+    for (std::map<std::string, ParamRange>::const_iterator it = space.ranges.begin(); it != space.ranges.end(); ++it) {
+        names.push_back(it->first);
+        ranges.push_back(it->second);
+        total *= it->second.count();
+    }
+
+    // if the grid is too big, we take evenly spaced points of it
+    double stride = std::max(1.0, total / std::max(1, max_candidates));
+    std::vector<SGBMParams> params;
+    for (double index = 0; index < total; index += stride) {
+        SGBMParams p = base;
+        double rest = std::floor(index);
+        for (size_t i = 0; i < names.size(); i++) {
+            int count = ranges[i].count();
+            int value_index = int(std::fmod(rest, count));
+            rest = std::floor(rest / count);
+            SearchSpace::set(p, names[i], ranges[i].value(value_index));
+        }
+        SearchSpace::constrain(p);
+        params.push_back(p);
+    }
+
+    return unique_candidates(evaluate(params));
+}
+
+std::vector<Candidate> AutoTuner::random_search(const SGBMParams &base, const SearchSpace &space, int count, unsigned seed)
+{
+    std::mt19937 generator(seed);
+    std::vector<SGBMParams> params;
+    for (int n = 0; n < count; n++) {
+        SGBMParams p = base;
+        for (std::map<std::string, ParamRange>::const_iterator it = space.ranges.begin(); it != space.ranges.end(); ++it) {
+            std::uniform_int_distribution<int> distribution(0, it->second.count() - 1);
+            SearchSpace::set(p, it->first, it->second.value(distribution(generator)));
+        }
+        SearchSpace::constrain(p);
+        params.push_back(p);
+    }
+
+    return unique_candidates(evaluate(params));
+}
+
+std::vector<Candidate> AutoTuner::coordinate_descent(const SGBMParams &base, const SearchSpace &space,
+                                                     double runtime_weight, int max_rounds)
+{
+    struct Objective {
+        double weight;
+        double operator()(const Candidate &c) const {
+            return c.valid ? c.bad_pixel_rate + weight * c.runtime_ms : std::numeric_limits<double>::infinity();
+        }
+    } objective = { runtime_weight };
+
+    SGBMParams current = base;
+    SearchSpace::constrain(current);
+    std::vector<Candidate> history = evaluate(std::vector<SGBMParams>(1, current));
+    Candidate best = history[0];
+
+    for (int round = 0; round < max_rounds; round++) {
+        bool improved = false;
+
+        for (std::map<std::string, ParamRange>::const_iterator it = space.ranges.begin(); it != space.ranges.end(); ++it) {
+            // all the values of this parameter (at most 32, evenly spaced), the others being fixed
+            const ParamRange &range = it->second;
+            int count = std::min(range.count(), 32);
+            std::vector<SGBMParams> trials;
+            for (int i = 0; i < count; i++) {
+                SGBMParams p = current;
+                int index = count > 1 ? i * (range.count() - 1) / (count - 1) : 0;
+                SearchSpace::set(p, it->first, range.value(index));
+                SearchSpace::constrain(p);
+                trials.push_back(p);
+            }
+
+            std::vector<Candidate> results = evaluate(trials);
+            history.insert(history.end(), results.begin(), results.end());
+            for (size_t i = 0; i < results.size(); i++) {
+                if (objective(results[i]) < objective(best) - 1e-12) {
+                    best = results[i];
+                    current = best.params;
+                    improved = true;
+                }
+            }
+        }
+
+        if (!improved)
+            break;
+    }
+
+    return unique_candidates(history);
+}
+
+/////////////////// Results //////////////////////
+
+void AutoTuner::mark_pareto_front(std::vector<Candidate> &candidates)
+{
+    // sorted by runtime, a candidate is on the front if it is more accurate than all the faster ones
+    std::vector<size_t> order(candidates.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (candidates[a].runtime_ms != candidates[b].runtime_ms)
+            return candidates[a].runtime_ms < candidates[b].runtime_ms;
+        return candidates[a].bad_pixel_rate < candidates[b].bad_pixel_rate;
+    });
+
+    double best_rate = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < order.size(); i++) {
+        Candidate &candidate = candidates[order[i]];
+        candidate.pareto = candidate.valid && candidate.bad_pixel_rate < best_rate;
+        if (candidate.pareto)
+            best_rate = candidate.bad_pixel_rate;
+    }
+}
+
+bool AutoTuner::write_csv(const std::string &filename, const std::vector<Candidate> &candidates)
+{
+    std::ofstream file(filename.c_str());
+    if (!file)
+        return false;
+
+    for (int i = 0; i < param_count; i++)
+        file << param_names[i] << ",";
+    file << "valid,bad_pixel_rate,runtime_ms,pareto" << std::endl;
+
+    for (size_t c = 0; c < candidates.size(); c++) {
+        for (int i = 0; i < param_count; i++)
+            file << SearchSpace::get(candidates[c].params, param_names[i]) << ",";
+        file << candidates[c].valid << "," << candidates[c].bad_pixel_rate << ","
+             << candidates[c].runtime_ms << "," << candidates[c].pareto << std::endl;
+    }
+    return bool(file);
+}
@@ -0,0 +1,106 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "opencv2/core/core.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sgbmparams.h"
+#include "threadpool.h"
+
+// automatic search of the semi-global block-matching parameters, against ground truth
+
+// a stereo pair with its ground truth disparity (CV_32FC1, in pixels, non-finite where unknown)
+struct StereoSample {
+    std::string name;
+    cv::Mat left;
+    cv::Mat right;
+    cv::Mat ground_truth;
+};
+
+// the values a parameter can take: min, min + step, ..., max
+struct ParamRange {
+    ParamRange() : min(0), max(0), step(1) {}
+    ParamRange(int min, int max, int step) : min(min), max(max), step(step) {}
+    int min;
+    int max;
+    int step;
+    int count() const { return step > 0 && max >= min ? (max - min) / step + 1 : 1; }
+    int value(int index) const { return min + index * step; }
+};
+
+// the parameters to search, by name (the names of the parameter files, see SGBMParams::write())
+// the parameters that are not in the space keep the value they have in the base parameters
+struct SearchSpace {
+    std::map<std::string, ParamRange> ranges;
+
+    // a space covering the parameters usually tuned
+    static SearchSpace default_space();
+
+    // "name: [min, max, step]" entries of a YAML or XML file
+    static bool load(const std::string &filename, SearchSpace &space);
+
+    // we set one parameter by name
+    static void set(SGBMParams &params, const std::string &name, int value);
+    static int get(const SGBMParams &params, const std::string &name);
+
+    // we enforce the constraints of the GUI: odd block size, number of disparities
+    // multiple of 16, and P2 > P1 (and a known engine and cost, the cost being only
+    // searched with the SGM engine)
+    static void constrain(SGBMParams &params);
+};
+
+// the evaluation of a set of parameters over all the samples
+struct Candidate {
+    SGBMParams params;
+    bool valid;              // false if OpenCV refused the parameters
+    double bad_pixel_rate;   // over all the pixels with a ground truth, invalid ones count as bad
+    double runtime_ms;       // mean time of one match
+    bool pareto;             // no other candidate is both more accurate and faster
+};
+
+class AutoTuner
+{
+public:
+    // the samples are matched in parallel on the pool (one candidate per thread)
+    AutoTuner(const std::vector<StereoSample> &samples, ThreadPool &pool, double bad_threshold = 2.0);
+
+    // we evaluate all the candidates (with a few thousands at most, sampled uniformly)
+    std::vector<Candidate> grid_search(const SGBMParams &base, const SearchSpace &space, int max_candidates);
+
+    // we evaluate random points of the space
+    std::vector<Candidate> random_search(const SGBMParams &base, const SearchSpace &space, int count, unsigned seed);
+
+    // starting from the base parameters, we try all the values of one parameter at a time
+    // (in parallel), keep the best one, and go on with the next parameter, until a full round
+    // does not improve the objective: bad pixel rate + runtime_weight * runtime (in ms)
+    std::vector<Candidate> coordinate_descent(const SGBMParams &base, const SearchSpace &space,
+                                              double runtime_weight, int max_rounds);
+
+    // we evaluate a list of parameters in parallel (already evaluated parameters are not recomputed)
+    std::vector<Candidate> evaluate(const std::vector<SGBMParams> &params);
+
+    // we flag the candidates on the Pareto front of accuracy and speed
+    static void mark_pareto_front(std::vector<Candidate> &candidates);
+
+    // we write all the candidates as CSV
+    static bool write_csv(const std::string &filename, const std::vector<Candidate> &candidates);
+
+private:
+    const std::vector<StereoSample> &samples;
+    ThreadPool &pool;
+    double bad_threshold;
+
+    // the candidates already evaluated, by parameters (as written in a parameter file)
+    std::map<std::string, Candidate> evaluated;
+
+    Candidate evaluate_one(const SGBMParams &params);
+    static std::string key(const SGBMParams &params);
+};
+
+// the bad pixel rate of a disparity map computed by OpenCV (CV_16SC1) against ground truth
+double bad_pixel_rate(const cv::Mat &disparity_16S, int min_disparity, const cv::Mat &ground_truth, double threshold);
+
+#endif // AUTOTUNE_H
@@ -0,0 +1,99 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// a queue of at most capacity items, passing them from one thread to another
+//
+// push() waits while the queue is full, so a slow consumer slows its producer down,
+// unless the producer would rather lose the oldest item (see push_dropping_oldest())
+// once closed, the items left can still be popped, then pop() returns false
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1), closed(false) {}
+
+    // false if the queue was closed (the item is not queued)
+    bool push(const T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (items.size() >= capacity && !closed)
+            not_full.wait(lock);
+        if (closed)
+            return false;
+        items.push_back(item);
+        not_empty.notify_one();
+        return true;
+    }
+
+    // we never wait: if the queue is full, the oldest item is replaced
+    // (dropped is set to true when that happens)
+    bool push_dropping_oldest(const T &item, bool &dropped)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dropped = false;
+        if (closed)
+            return false;
+        if (items.size() >= capacity) {
+            items.pop_front();
+            dropped = true;
+        }
+        items.push_back(item);
+        not_empty.notify_one();
+        return true;
+    }
+
+    // we wait for an item; false when the queue is closed and empty
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (items.empty() && !closed)
+            not_empty.wait(lock);
+        if (items.empty())
+            return false;
+        item = items.front();
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    // we wake up all the threads waiting on the queue
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+    // we discard the items left, and open the queue again
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        items.clear();
+        closed = false;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+
+    BoundedQueue(const BoundedQueue &);
+    BoundedQueue &operator=(const BoundedQueue &);
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,65 @@
+#include "bufferpool.h"
+
+bool BufferPool::Key::operator<(const Key &other) const
+{
+    if (name != other.name)
+        return name < other.name;
+    if (rows != other.rows)
+        return rows < other.rows;
+    if (cols != other.cols)
+        return cols < other.cols;
+    return type < other.type;
+}
+
+BufferPool::BufferPool() :
+    frame_count(0),
+    last_frame_count(0),
+    total_count(0)
+{
+}
+
+cv::Mat &BufferPool::get(const std::string &name, int rows, int cols, int type)
+{
+    Key key = { name, rows, cols, type };
+    std::map<Key, cv::Mat>::iterator it = buffers.find(key);
+    if (it == buffers.end()) {
+        it = buffers.insert(std::make_pair(key, cv::Mat(rows, cols, type))).first;
+        frame_count++;
+        total_count++;
+    }
+    return it->second;
+}
+
+cv::Mat &BufferPool::get(const std::string &name, const cv::Size &size, int type)
+{
+    return get(name, size.height, size.width, type);
+}
+
+void BufferPool::clear()
+{
+    buffers.clear();
+    frame_start_data.clear();
+}
+
+void BufferPool::begin_frame()
+{
+    frame_count = 0;
+    frame_start_data.clear();
+    for (std::map<Key, cv::Mat>::const_iterator it = buffers.begin(); it != buffers.end(); ++it)
+        frame_start_data[it->first] = it->second.datastart;
+}
+
+int BufferPool::end_frame()
+{
+    // a buffer whose data moved was reallocated by OpenCV (wrong size or type, or shared)
+    for (std::map<Key, cv::Mat>::const_iterator it = buffers.begin(); it != buffers.end(); ++it) {
+        std::map<Key, const uchar *>::const_iterator start = frame_start_data.find(it->first);
+        if (start != frame_start_data.end() && start->second != it->second.datastart) {
+            frame_count++;
+            total_count++;
+        }
+    }
+
+    last_frame_count = frame_count;
+    return frame_count;
+}
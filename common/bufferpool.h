@@ -0,0 +1,54 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include "opencv2/core/core.hpp"
+
+#include <map>
+#include <string>
+
+// a set of cv::Mat buffers that are kept between two computations
+//
+// a buffer is identified by a name and by its size and type, so that the
+// intermediate images of a computation (and of each of its pyramid levels)
+// are only allocated the first time, and then reused: OpenCV functions
+// writing into a buffer of the right size and type do not allocate memory
+//
+// the pool also counts the allocations made during a frame (between begin_frame()
+// and end_frame()), including the ones made by OpenCV when it had to reallocate a
+// buffer, so that we can check that steady-state tuning does not allocate anything
+class BufferPool
+{
+public:
+    BufferPool();
+
+    // the buffer with this name, size and type (allocated if it does not exist yet)
+    cv::Mat &get(const std::string &name, int rows, int cols, int type);
+    cv::Mat &get(const std::string &name, const cv::Size &size, int type);
+
+    // we free all the buffers (for example when the images change size)
+    void clear();
+
+    // the allocation counter
+    void begin_frame();
+    int end_frame();  // returns the number of allocations made during the frame
+    int last_frame_allocations() const { return last_frame_count; }
+    long total_allocations() const { return total_count; }
+
+private:
+    struct Key {
+        std::string name;
+        int rows;
+        int cols;
+        int type;
+        bool operator<(const Key &other) const;
+    };
+
+    std::map<Key, cv::Mat> buffers;
+    std::map<Key, const uchar *> frame_start_data;  // the data pointers at the start of the frame
+
+    int frame_count;
+    int last_frame_count;
+    long total_count;
+};
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,17 @@
+#include "directories.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cerrno>
+
+bool make_directories(const std::string &directory)
+{
+    for (size_t slash = directory.find('/', 1); ; slash = directory.find('/', slash + 1)) {
+        std::string parent = directory.substr(0, slash);
+        if (!parent.empty() && mkdir(parent.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+        if (slash == std::string::npos)
+            return true;
+    }
+}
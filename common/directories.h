@@ -0,0 +1,10 @@
+#ifndef DIRECTORIES_H
+#define DIRECTORIES_H
+
+#include <string>
+
+// we create a directory and its parents, like mkdir -p
+// (true if the directory exists afterwards)
+bool make_directories(const std::string &directory);
+
+#endif // DIRECTORIES_H
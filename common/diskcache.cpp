@@ -0,0 +1,294 @@
+#include "diskcache.h"
+
+#include "opencv2/highgui/highgui.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+#include "directories.h"
+#include "mappedfile.h"
+
+static const char *extension = ".png";
+
+// the maps waiting to be written (beyond that, the writer is clearly too slow)
+static const size_t pending_capacity = 8;
+
+static bool ends_with(const std::string &text, const std::string &end)
+{
+    return text.size() >= end.size() && text.compare(text.size() - end.size(), end.size(), end) == 0;
+}
+
+static unsigned long long fnv1a(const std::string &text, unsigned long long hash)
+{
+    for (size_t i = 0; i < text.size(); i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+DiskCache::DiskCache() :
+    budget(0),
+    bytes(0),
+    hits(0),
+    misses(0),
+    writes(0),
+    use_clock(0),
+    pending(pending_capacity)
+{
+}
+
+DiskCache::~DiskCache()
+{
+    close();
+}
+
+bool DiskCache::open(const std::string &directory, size_t budget_bytes)
+{
+    {
+        // reopening the same directory only changes the budget
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!this->directory.empty() && this->directory == directory) {
+            budget = budget_bytes;
+            evict();
+            return true;
+        }
+    }
+    close();
+    if (!make_directories(directory))
+        return false;
+
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    this->directory = directory;
+    budget = budget_bytes;
+    bytes = 0;
+    files.clear();
+    uses.clear();
+
+    // the files of the previous sessions (and the temporary files of an interrupted write)
+    while (struct dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        struct stat status;
+        if (stat(path(name).c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+            continue;
+        if (ends_with(name, ".tmp")) {
+            std::remove(path(name).c_str());
+        } else if (ends_with(name, extension)) {
+            add_file(name, size_t(status.st_size), (long long)status.st_mtime * 1000000);
+        }
+    }
+    closedir(dir);
+    evict();
+
+    pending.reset();
+    writer = std::thread(&DiskCache::write_files, this);
+    return true;
+}
+
+void DiskCache::close()
+{
+    // the maps already queued are still written
+    pending.close();
+    if (writer.joinable())
+        writer.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    directory.clear();
+    files.clear();
+    uses.clear();
+    bytes = 0;
+}
+
+bool DiskCache::is_open() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return !directory.empty();
+}
+
+void DiskCache::set_budget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+    evict();
+}
+
+bool DiskCache::contains(const std::string &key) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return files.find(file_name(key)) != files.end();
+}
+
+bool DiskCache::find(const std::string &key, cv::Mat &disparity)
+{
+    std::string name = file_name(key), filename;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (directory.empty())
+            return false;
+        if (files.find(name) == files.end()) {
+            misses++;
+            return false;
+        }
+        filename = path(name);
+    }
+
+    // we decode the PNG straight from the mapping of the file
+    cv::Mat stored;
+    MappedFile file;
+    if (file.open(filename))
+        stored = cv::imdecode(cv::Mat(1, int(file.size()), CV_8UC1, file.bytes()), cv::IMREAD_UNCHANGED);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stored.type() != CV_16UC1) {
+        // deleted or damaged in the meantime
+        remove_file(name);
+        std::remove(filename.c_str());
+        misses++;
+        return false;
+    }
+
+    // the modification time of the file is its last use, across sessions
+    std::map<std::string, File>::iterator it = files.find(name);
+    if (it != files.end())
+        add_file(name, it->second.size, use_time());
+    utime(filename.c_str(), 0);
+    hits++;
+
+    // the maps are stored with an offset, since PNG only has unsigned 16 bits pixels
+    stored.convertTo(disparity, CV_16S, 1, -32768);
+    return true;
+}
+
+void DiskCache::insert(const std::string &key, const cv::Mat &disparity)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (directory.empty() || budget == 0 || files.find(file_name(key)) != files.end())
+            return;
+    }
+
+    Pending map;
+    map.name = file_name(key);
+    map.disparity = disparity.clone();
+    bool dropped;
+    pending.push_dropping_oldest(map, dropped);
+}
+
+DiskCache::Statistics DiskCache::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Statistics statistics;
+    statistics.hits = hits;
+    statistics.misses = misses;
+    statistics.writes = writes;
+    statistics.bytes = bytes;
+    statistics.files = int(files.size());
+    return statistics;
+}
+
+// two 64 bits hashes of the key and of the version of OpenCV
+std::string DiskCache::file_name(const std::string &key)
+{
+    std::string text = key + " opencv " + CV_VERSION;
+    char name[48];
+    std::snprintf(name, sizeof(name), "%016llx%016llx%s",
+                  fnv1a(text, 14695981039346656037ULL), fnv1a(text, 0x9e3779b97f4a7c15ULL), extension);
+    return name;
+}
+
+std::string DiskCache::path(const std::string &name) const
+{
+    return directory + "/" + name;
+}
+
+// the files only keep the time of their last use to the second, so within a session
+// we make sure that each use comes strictly after the previous one
+// (the mutex must be locked)
+long long DiskCache::use_time()
+{
+    use_clock = std::max(use_clock + 1, (long long)std::time(0) * 1000000);
+    return use_clock;
+}
+
+// the writer thread: we encode the queued maps, and write them under a temporary
+// name first, so that a map is never read half written
+void DiskCache::write_files()
+{
+    std::vector<int> compression;
+    compression.push_back(cv::IMWRITE_PNG_COMPRESSION);
+    compression.push_back(1);  // fast: the maps compress well anyway
+
+    Pending map;
+    while (pending.pop(map)) {
+        std::string filename, temporary;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            filename = path(map.name);
+        }
+        temporary = filename + ".tmp";
+
+        cv::Mat stored;
+        map.disparity.convertTo(stored, CV_16U, 1, 32768);
+        std::vector<uchar> encoded;
+        if (!cv::imencode(extension, stored, encoded, compression))
+            continue;
+
+        FILE *file = std::fopen(temporary.c_str(), "wb");
+        if (!file)
+            continue;
+        bool written = std::fwrite(&encoded[0], 1, encoded.size(), file) == encoded.size();
+        written = std::fclose(file) == 0 && written;
+        if (!written || std::rename(temporary.c_str(), filename.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        add_file(map.name, encoded.size(), use_time());
+        writes++;
+        evict();
+    }
+}
+
+// we record a file, or its new size and last use if it is already known
+// (the mutex must be locked)
+void DiskCache::add_file(const std::string &name, size_t size, long long last_use)
+{
+    remove_file(name);
+    File file = { size, last_use };
+    files[name] = file;
+    uses.insert(std::make_pair(last_use, name));
+    bytes += size;
+}
+
+// the mutex must be locked
+void DiskCache::remove_file(const std::string &name)
+{
+    std::map<std::string, File>::iterator it = files.find(name);
+    if (it == files.end())
+        return;
+    uses.erase(std::make_pair(it->second.last_use, name));
+    bytes -= it->second.size;
+    files.erase(it);
+}
+
+// the least recently used files go first (the mutex must be locked)
+void DiskCache::evict()
+{
+    while (bytes > budget && !uses.empty()) {
+        std::string oldest = uses.begin()->second;
+        std::remove(path(oldest).c_str());
+        remove_file(oldest);
+    }
+}
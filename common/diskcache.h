@@ -0,0 +1,97 @@
+#ifndef DISKCACHE_H
+#define DISKCACHE_H
+
+#include "opencv2/core/core.hpp"
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "boundedqueue.h"
+
+// the disparity maps computed in the previous sessions, kept in a directory, so that
+// reopening the same images with the same parameters does not match them again
+//
+// the files are content-addressed: their name is a hash of the key given by the caller
+// (the images and the parameters, see DisparityCache) and of the version of OpenCV,
+// since another version may compute other maps
+// each map is a 16 bits PNG (lossless, and a few times smaller than the raw map);
+// reading maps the file in memory and decodes it from there; writing is done by a
+// background thread, so that storing a map never delays its display
+// when the files take more space than the budget, the least recently used ones are deleted
+class DiskCache
+{
+public:
+    struct Statistics {
+        long hits;
+        long misses;
+        long writes;
+        size_t bytes;  // size of the files
+        int files;
+    };
+
+    DiskCache();
+    ~DiskCache();
+
+    // we create the directory if needed, and take the files it already holds into account
+    // (if this directory is already open, only the budget changes)
+    bool open(const std::string &directory, size_t budget_bytes);
+    void close();
+    bool is_open() const;
+
+    void set_budget(size_t bytes);
+
+    // whether a map is stored with this key (without reading it)
+    bool contains(const std::string &key) const;
+
+    // we read the map stored with this key (CV_16SC1)
+    bool find(const std::string &key, cv::Mat &disparity);
+
+    // we queue a copy of the map, to be written in the background
+    // (if the writes can not keep up, the oldest queued maps are not stored)
+    void insert(const std::string &key, const cv::Mat &disparity);
+
+    Statistics statistics() const;
+
+private:
+    struct File {
+        size_t size;
+        long long last_use;  // in microseconds since the epoch (from the modification time of the file)
+    };
+
+    struct Pending {
+        std::string name;
+        cv::Mat disparity;
+    };
+
+    mutable std::mutex mutex;
+    std::string directory;
+    size_t budget;
+    size_t bytes;
+    long hits;
+    long misses;
+    long writes;
+    long long use_clock;
+    std::map<std::string, File> files;  // by file name
+    std::set<std::pair<long long, std::string> > uses;  // the files by last use, the oldest first
+
+    BoundedQueue<Pending> pending;
+    std::thread writer;
+
+    static std::string file_name(const std::string &key);
+    std::string path(const std::string &name) const;
+    long long use_time();
+    void add_file(const std::string &name, size_t size, long long last_use);
+    void remove_file(const std::string &name);
+    void write_files();
+    void evict();
+
+    DiskCache(const DiskCache &);
+    DiskCache &operator=(const DiskCache &);
+};
+
+#endif // DISKCACHE_H
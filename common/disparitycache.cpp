@@ -0,0 +1,128 @@
+#include "disparitycache.h"
+
+#include <cstdio>
+#include <cstring>
+
+static size_t map_bytes(const cv::Mat &disparity)
+{
+    return disparity.total() * disparity.elemSize();
+}
+
+DisparityCache::DisparityCache(size_t budget_bytes) :
+    budget(budget_bytes),
+    bytes(0),
+    hits(0),
+    misses(0)
+{
+}
+
+void DisparityCache::set_budget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+    evict();
+}
+
+bool DisparityCache::find(const std::string &key, cv::Mat &disparity)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, std::list<Entry>::iterator>::iterator it = index.find(key);
+    if (it == index.end()) {
+        if (budget > 0)
+            misses++;
+        return false;
+    }
+
+    entries.splice(entries.begin(), entries, it->second);
+    disparity = it->second->disparity;
+    hits++;
+    return true;
+}
+
+void DisparityCache::insert(const std::string &key, const cv::Mat &disparity)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t size = map_bytes(disparity);
+    if (size > budget)
+        return;
+
+    std::map<std::string, std::list<Entry>::iterator>::iterator it = index.find(key);
+    if (it != index.end()) {
+        bytes -= map_bytes(it->second->disparity);
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.disparity = disparity.clone();
+    entries.push_front(entry);
+    index[key] = entries.begin();
+    bytes += size;
+    evict();
+}
+
+void DisparityCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+    bytes = 0;
+}
+
+DisparityCache::Statistics DisparityCache::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Statistics statistics;
+    statistics.hits = hits;
+    statistics.misses = misses;
+    statistics.bytes = bytes;
+    statistics.entries = int(entries.size());
+    return statistics;
+}
+
+// the mutex must be locked
+void DisparityCache::evict()
+{
+    while (bytes > budget && !entries.empty()) {
+        bytes -= map_bytes(entries.back().disparity);
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+}
+
+std::string DisparityCache::image_key(const cv::Mat &left, const cv::Mat &right)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    const cv::Mat *images[] = { &left, &right };
+    for (int i = 0; i < 2; i++) {
+        const cv::Mat &image = *images[i];
+        unsigned long long header[] = { (unsigned long long)image.rows, (unsigned long long)image.cols,
+                                        (unsigned long long)image.type() };
+        for (int j = 0; j < 3; j++) {
+            hash ^= header[j];
+            hash *= 1099511628211ULL;
+        }
+
+        // the rows one after the other (they may not be contiguous), 8 bytes at a time
+        size_t row_bytes = image.cols * image.elemSize();
+        for (int y = 0; y < image.rows; y++) {
+            const unsigned char *row = image.ptr(y);
+            size_t x = 0;
+            for (; x + 8 <= row_bytes; x += 8) {
+                unsigned long long word;
+                std::memcpy(&word, row + x, 8);
+                hash ^= word;
+                hash *= 1099511628211ULL;
+            }
+            for (; x < row_bytes; x++) {
+                hash ^= row[x];
+                hash *= 1099511628211ULL;
+            }
+        }
+    }
+
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", hash);
+    return text;
+}
@@ -0,0 +1,65 @@
+#ifndef DISPARITYCACHE_H
+#define DISPARITYCACHE_H
+
+#include "opencv2/core/core.hpp"
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+// the disparity maps computed recently, so that going back to parameters already
+// tried (toggling a slider back and forth, comparing two settings) is instant
+//
+// the maps are identified by a key, built by the caller from a hash of the images
+// (see image_key()) and from the parameters; when the maps take more memory than the
+// budget, the least recently used ones are evicted
+// the cache can be used from several threads
+class DisparityCache
+{
+public:
+    struct Statistics {
+        long hits;
+        long misses;
+        size_t bytes;  // memory used by the maps
+        int entries;
+    };
+
+    explicit DisparityCache(size_t budget_bytes = 256 << 20);
+
+    // 0 disables the cache
+    void set_budget(size_t bytes);
+
+    // we return the map stored with this key (sharing its data: it must not be modified)
+    bool find(const std::string &key, cv::Mat &disparity);
+
+    // we store a copy of the map
+    void insert(const std::string &key, const cv::Mat &disparity);
+
+    void clear();
+    Statistics statistics() const;
+
+    // a hash of the pixels of a stereo pair (64 bits FNV-1a over 8 bytes words, as hexadecimal)
+    static std::string image_key(const cv::Mat &left, const cv::Mat &right);
+
+private:
+    struct Entry {
+        std::string key;
+        cv::Mat disparity;
+    };
+
+    mutable std::mutex mutex;
+    size_t budget;
+    size_t bytes;
+    long hits;
+    long misses;
+
+    // the most recently used first
+    std::list<Entry> entries;
+    std::map<std::string, std::list<Entry>::iterator> index;
+
+    void evict();
+};
+
+#endif // DISPARITYCACHE_H
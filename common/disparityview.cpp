@@ -0,0 +1,83 @@
+#include "disparityview.h"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// the "jet" color map, from blue (far) to red (near)
+static QRgb jet_color(int index)
+{
+    double t = index / 255.0;
+    double r = std::min(1.0, std::max(0.0, 1.5 - std::fabs(4 * t - 3)));
+    double g = std::min(1.0, std::max(0.0, 1.5 - std::fabs(4 * t - 2)));
+    double b = std::min(1.0, std::max(0.0, 1.5 - std::fabs(4 * t - 1)));
+    return qRgb(int(r * 255), int(g * 255), int(b * 255));
+}
+
+DisparityView::DisparityView() :
+    colormap(false),
+    gray_table(256),
+    jet_table(256),
+    next_image(0),
+    allocation_count(0)
+{
+    for (int i = 0; i < 256; i++) {
+        gray_table[i] = qRgb(i, i, i);
+        jet_table[i] = jet_color(i);
+    }
+}
+
+void DisparityView::set_colormap(bool enabled)
+{
+    colormap = enabled;
+}
+
+QImage DisparityView::render(const cv::Mat &disparity, const QSize &max_size, StageTimer *timer)
+{
+    if (disparity.empty() || max_size.isEmpty())
+        return QImage();
+
+    // the min and max are taken over the full resolution map, so that the colors
+    // do not change with the display size
+    double min_value, max_value;
+    {
+        StageTimer::Scope scope(timer, "normalize");
+        cv::minMaxLoc(disparity, &min_value, &max_value);
+    }
+    double alpha = (max_value > min_value) ? 255.0 / (max_value - min_value) : 0.0;
+    double beta = -min_value * alpha;
+
+    // the size the map will be displayed at
+    QSize size(disparity.cols, disparity.rows);
+    size.scale(max_size, Qt::KeepAspectRatio);
+    size = size.expandedTo(QSize(1, 1));
+
+    // we only sample the pixels that will be displayed
+    const cv::Mat *source = &disparity;
+    if (size.width() != disparity.cols || size.height() != disparity.rows) {
+        StageTimer::Scope scope(timer, "resize");
+        cv::resize(disparity, resized_disparity, cv::Size(size.width(), size.height()), 0, 0, cv::INTER_NEAREST);
+        source = &resized_disparity;
+    }
+
+    // we write the 8 bits values directly in the pixels of an image nobody else holds (writing
+    // in a shared QImage would copy it); when the GUI still holds all of them, we replace one,
+    // and the GUI keeps its copy
+    StageTimer::Scope scope(timer, "convert");
+    int index = 0;
+    while (index < IMAGE_COUNT && !(images[index].size() == size && images[index].isDetached()))
+        index++;
+    if (index == IMAGE_COUNT) {
+        index = next_image;
+        next_image = (next_image + 1) % IMAGE_COUNT;
+        images[index] = QImage(size, QImage::Format_Indexed8);
+        allocation_count++;
+    }
+    QImage &image = images[index];
+    cv::Mat pixels(image.height(), image.width(), CV_8UC1, image.bits(), image.bytesPerLine());
+    source->convertTo(pixels, CV_8U, alpha, beta);
+
+    image.setColorTable(colormap ? jet_table : gray_table);
+    return image;
+}
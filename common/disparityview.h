@@ -0,0 +1,52 @@
+#ifndef DISPARITYVIEW_H
+#define DISPARITYVIEW_H
+
+#include "opencv2/core/core.hpp"
+
+#include <QImage>
+#include <QSize>
+#include <QVector>
+
+#include "stagetimer.h"
+
+// converts 16 bits signed disparity maps into images that can be displayed in the GUI
+//
+// instead of normalizing the whole map, converting it to 8 bits, then to RGB, then
+// resizing the resulting image, we first sample the map down to the size it will be
+// displayed at, then scale it to 8 bits directly into the pixels of an indexed QImage
+// (OpenCV vectorizes both steps), and the color table of the image does the rest
+// the output images are kept between calls: a few of them are used in turn, since the GUI
+// still holds the images it displays (a QImage shares its pixels), and an image is only
+// written again once the GUI has released it; no memory is allocated as long as the
+// display size does not change and the GUI keeps up (see allocations())
+class DisparityView
+{
+public:
+    DisparityView();
+
+    // false: grayscale (the default), true: "jet" color map
+    void set_colormap(bool enabled);
+
+    // we return the map as an indexed image, resized to fit in max_size (keeping the aspect ratio)
+    // the values are stretched over the whole range, like cv::normalize(..., CV_MINMAX)
+    // with a timer, the "normalize", "resize" and "convert" steps are timed
+    QImage render(const cv::Mat &disparity, const QSize &max_size, StageTimer *timer = 0);
+
+    // the number of images allocated by render() so far
+    long allocations() const { return allocation_count; }
+
+private:
+    bool colormap;
+    QVector<QRgb> gray_table;
+    QVector<QRgb> jet_table;
+
+    cv::Mat resized_disparity;  // the map sampled to the display size
+
+    // the 8 bits outputs, reused between calls once the GUI released them
+    enum { IMAGE_COUNT = 3 };
+    QImage images[IMAGE_COUNT];
+    int next_image;             // the one replaced when none is free
+    long allocation_count;
+};
+
+#endif // DISPARITYVIEW_H
@@ -0,0 +1,90 @@
+#include "imageloader.h"
+
+#include "opencv2/highgui/highgui.hpp"
+
+#include <QMutexLocker>
+
+#include "previewimage.h"
+
+ImageLoader::ImageLoader(QObject *parent) :
+    QThread(parent),
+    stopping(false),
+    stage_timer(0)
+{
+    qRegisterMetaType<LoadedImage>("LoadedImage");
+}
+
+ImageLoader::~ImageLoader()
+{
+    stop();
+}
+
+void ImageLoader::load(const QString &filename, int target, const QSize &preview_size)
+{
+    QMutexLocker locker(&mutex);
+    Request request;
+    request.filename = filename;
+    request.target = target;
+    request.preview_size = preview_size;
+    requests.append(request);
+    condition.wakeOne();
+}
+
+void ImageLoader::set_stage_timer(StageTimer *timer)
+{
+    stage_timer = timer;
+}
+
+void ImageLoader::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        requests.clear();
+        condition.wakeOne();
+    }
+    wait();
+}
+
+bool ImageLoader::decode(const QString &filename, cv::Mat &image)
+{
+    // we convert filename from QString to std::string (needed by OpenCV)
+    std::string filename_s = filename.toUtf8().constData();
+
+    image = cv::imread(filename_s, CV_LOAD_IMAGE_GRAYSCALE);
+    return !image.empty();
+}
+
+void ImageLoader::run()
+{
+    forever {
+        Request request;
+        {
+            QMutexLocker locker(&mutex);
+            while (requests.isEmpty() && !stopping)
+                condition.wait(&mutex);
+            if (stopping)
+                return;
+            request = requests.takeFirst();
+        }
+
+        LoadedImage result;
+        result.filename = request.filename;
+        result.target = request.target;
+
+        bool decoded;
+        {
+            StageTimer::Scope scope(stage_timer, "decode");
+            decoded = decode(request.filename, result.image);
+        }
+
+        if (decoded) {
+            StageTimer::Scope scope(stage_timer, "preview");
+            result.preview = preview_image(result.image, request.preview_size);
+        } else {
+            result.error = "Can't read " + request.filename;
+        }
+
+        emit loaded(result);
+    }
+}
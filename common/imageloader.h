@@ -0,0 +1,78 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include "opencv2/core/core.hpp"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+#include <QList>
+#include <QMetaType>
+#include <QSize>
+#include <QString>
+
+#include "stagetimer.h"
+
+// a picture loaded by the ImageLoader
+struct LoadedImage {
+    QString filename;
+    int target;          // given by the caller with the request (for example, which view it is)
+    cv::Mat image;       // 8 bits gray, decoded once, what the matchers use
+    QImage preview;      // the picture downscaled for the GUI
+    QString error;       // empty on success
+};
+
+Q_DECLARE_METATYPE(LoadedImage)
+
+// loads pictures in a background thread, so that the GUI never blocks on large files
+//
+// each file is decoded only once, straight to gray (the matchers work on gray pictures,
+// and a gray decode needs a third of the memory of a color one); the GUI only gets a
+// small preview, downscaled from the decoded picture instead of decoding the file again
+// the requests are processed in order, and each one is answered by loaded()
+class ImageLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit ImageLoader(QObject *parent = 0);
+    ~ImageLoader();
+
+    // we queue a request; the preview fits in preview_size
+    void load(const QString &filename, int target, const QSize &preview_size);
+
+    // the timer receiving the "decode" and "preview" durations
+    // (must be set before the thread is started, and outlive it)
+    void set_stage_timer(StageTimer *timer);
+
+    // we ask the thread to terminate, and wait for it (the pending requests are dropped)
+    void stop();
+
+    // we decode a picture to gray (in the calling thread)
+    static bool decode(const QString &filename, cv::Mat &image);
+
+signals:
+    // emitted (from the loader thread) when a request has been processed, even if it failed
+    void loaded(const LoadedImage &image);
+
+protected:
+    void run();
+
+private:
+    struct Request {
+        QString filename;
+        int target;
+        QSize preview_size;
+    };
+
+    // shared with the GUI thread, protected by the mutex
+    QMutex mutex;
+    QWaitCondition condition;
+    QList<Request> requests;
+    bool stopping;
+
+    StageTimer *stage_timer;
+};
+
+#endif // IMAGELOADER_H
@@ -0,0 +1,34 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// a whole file mapped in memory (POSIX mmap), read-only on disk
+//
+// the pages are private: writing to them is allowed, but only changes the memory of
+// this process (so a cv::Mat pointing into the mapping can be modified by mistake
+// without corrupting the file, or crashing)
+// the pages are only read from the disk when they are first accessed
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string &filename);
+    void close();
+    bool is_open() const { return data != 0; }
+
+    unsigned char *bytes() const { return static_cast<unsigned char *>(data); }
+    size_t size() const { return length; }
+
+private:
+    void *data;
+    size_t length;
+
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,82 @@
+#include "pfm.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+// true if this machine stores floats with the least significant byte first
+static bool is_little_endian()
+{
+    const unsigned int one = 1;
+    return *reinterpret_cast<const unsigned char *>(&one) == 1;
+}
+
+static void swap_bytes(float *values, int count)
+{
+    for (int i = 0; i < count; i++) {
+        unsigned char *bytes = reinterpret_cast<unsigned char *>(values + i);
+        std::swap(bytes[0], bytes[3]);
+        std::swap(bytes[1], bytes[2]);
+    }
+}
+
+cv::Mat read_pfm(const std::string &filename)
+{
+    FILE *file = std::fopen(filename.c_str(), "rb");
+    if (!file)
+        return cv::Mat();
+
+    // the header: "Pf" (one channel), the size, and the scale (negative for little-endian)
+    char type[3] = { 0 };
+    int width = 0, height = 0;
+    float scale = 0;
+    if (std::fscanf(file, "%2s %d %d %f", type, &width, &height, &scale) != 4 ||
+        std::strcmp(type, "Pf") != 0 || width <= 0 || height <= 0) {
+        std::fclose(file);
+        return cv::Mat();
+    }
+    std::fgetc(file);  // the single whitespace character ending the header
+
+    // the rows are stored from the bottom to the top
+    cv::Mat disparity(height, width, CV_32FC1);
+    bool swap = (scale < 0) != is_little_endian();
+    for (int y = height - 1; y >= 0; y--) {
+        float *row = disparity.ptr<float>(y);
+        if (std::fread(row, sizeof(float), width, file) != (size_t)width) {
+            std::fclose(file);
+            return cv::Mat();
+        }
+        if (swap)
+            swap_bytes(row, width);
+    }
+
+    std::fclose(file);
+    return disparity;
+}
+
+bool write_pfm(const std::string &filename, const cv::Mat &disparity)
+{
+    CV_Assert(disparity.type() == CV_32FC1);
+
+    FILE *file = std::fopen(filename.c_str(), "wb");
+    if (!file)
+        return false;
+
+    std::fprintf(file, "Pf\n%d %d\n%f\n", disparity.cols, disparity.rows, is_little_endian() ? -1.0 : 1.0);
+    bool ok = true;
+    for (int y = disparity.rows - 1; y >= 0 && ok; y--)
+        ok = std::fwrite(disparity.ptr<float>(y), sizeof(float), disparity.cols, file) == (size_t)disparity.cols;
+
+    return std::fclose(file) == 0 && ok;
+}
+
+cv::Mat disparity_to_pixels(const cv::Mat &disparity_16S, int min_disparity)
+{
+    CV_Assert(disparity_16S.type() == CV_16SC1);
+
+    cv::Mat pixels;
+    disparity_16S.convertTo(pixels, CV_32F, 1.0 / 16);
+    pixels.setTo(std::numeric_limits<float>::infinity(), disparity_16S < min_disparity * 16);
+    return pixels;
+}
@@ -0,0 +1,21 @@
+#ifndef PFM_H
+#define PFM_H
+
+#include "opencv2/core/core.hpp"
+
+#include <string>
+
+// the Portable Float Map format, used by the Middlebury stereo datasets
+// for their ground truth disparities (in pixels, infinity for unknown values)
+
+// we read a single channel PFM file into a CV_32FC1 matrix (empty on error)
+cv::Mat read_pfm(const std::string &filename);
+
+// we write a CV_32FC1 matrix into a single channel PFM file
+bool write_pfm(const std::string &filename, const cv::Mat &disparity);
+
+// we convert a disparity map computed by OpenCV (CV_16SC1, in 1/16 of pixel) to pixels
+// (CV_32FC1), with the invalid values (below min_disparity) set to infinity
+cv::Mat disparity_to_pixels(const cv::Mat &disparity_16S, int min_disparity);
+
+#endif // PFM_H
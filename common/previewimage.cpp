@@ -0,0 +1,23 @@
+#include "previewimage.h"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+QImage preview_image(const cv::Mat &image, const QSize &max_size)
+{
+    if (image.empty() || max_size.isEmpty() || (image.channels() != 1 && image.channels() != 3))
+        return QImage();
+
+    QSize size(image.cols, image.rows);
+    if (size.width() > max_size.width() || size.height() > max_size.height())
+        size.scale(max_size, Qt::KeepAspectRatio);
+    size = size.expandedTo(QSize(1, 1));
+
+    cv::Mat resized = image;
+    if (size.width() != image.cols || size.height() != image.rows)
+        cv::resize(image, resized, cv::Size(size.width(), size.height()), 0, 0, cv::INTER_AREA);
+
+    QImage preview(size, QImage::Format_RGB888);
+    cv::Mat pixels(preview.height(), preview.width(), CV_8UC3, preview.bits(), preview.bytesPerLine());
+    cv::cvtColor(resized, pixels, resized.channels() == 1 ? cv::COLOR_GRAY2RGB : cv::COLOR_BGR2RGB);
+    return preview;
+}
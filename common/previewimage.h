@@ -0,0 +1,15 @@
+#ifndef PREVIEWIMAGE_H
+#define PREVIEWIMAGE_H
+
+#include "opencv2/core/core.hpp"
+
+#include <QImage>
+#include <QSize>
+
+// we convert a picture already decoded by OpenCV (gray or BGR) into an image for the GUI,
+// resized to fit in max_size (keeping the aspect ratio, never enlarged)
+// the picture is only downscaled and converted once, straight into the pixels of the
+// QImage, so that the file does not have to be decoded a second time by Qt
+QImage preview_image(const cv::Mat &image, const QSize &max_size);
+
+#endif // PREVIEWIMAGE_H
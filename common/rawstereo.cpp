@@ -0,0 +1,241 @@
+#include "rawstereo.h"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+static const char magic[8] = { 'S', 'T', 'E', 'R', 'E', 'O', '8', '\0' };
+static const unsigned version = 1;
+static const size_t header_size = 4096;
+static const size_t row_alignment = 64;
+
+// the header fields, written byte by byte so that the files do not depend on the endianness
+static void put_uint(unsigned char *bytes, unsigned long long value, int size)
+{
+    for (int i = 0; i < size; i++)
+        bytes[i] = (unsigned char)(value >> (8 * i));
+}
+
+static unsigned long long get_uint(const unsigned char *bytes, int size)
+{
+    unsigned long long value = 0;
+    for (int i = 0; i < size; i++)
+        value |= (unsigned long long)bytes[i] << (8 * i);
+    return value;
+}
+
+static void put_double(unsigned char *bytes, double value)
+{
+    unsigned long long bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put_uint(bytes, bits, 8);
+}
+
+static double get_double(const unsigned char *bytes)
+{
+    unsigned long long bits = get_uint(bytes, 8);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static size_t aligned_stride(int width)
+{
+    return (size_t(width) + row_alignment - 1) / row_alignment * row_alignment;
+}
+
+// the frames are matrices pointing into the mapping, whose reference count (shared by all
+// their copies and regions) holds a reference to the mapping: when OpenCV releases the
+// last of them, it gives the buffer back to this allocator, which drops the reference
+class MappedFrameAllocator : public cv::MatAllocator
+{
+public:
+    // the frames are never reallocated by OpenCV (a matrix is only given a new buffer
+    // of the default allocator)
+    cv::UMatData *allocate(int, const int *, int, void *, size_t *, int, cv::UMatUsageFlags) const
+    {
+        return 0;
+    }
+
+    bool allocate(cv::UMatData *, int, cv::UMatUsageFlags) const
+    {
+        return false;
+    }
+
+    void deallocate(cv::UMatData *data) const
+    {
+        delete static_cast<std::shared_ptr<MappedFile> *>(data->userdata);
+        delete data;
+    }
+};
+
+static cv::Mat mapped_plane(const std::shared_ptr<MappedFile> &file, unsigned char *pixels,
+                            const cv::Size &size, size_t stride)
+{
+    // never destroyed, since a frame may be released while the program exits
+    static MappedFrameAllocator *allocator = new MappedFrameAllocator;
+
+    cv::Mat plane(size, CV_8UC1, pixels, stride);
+    cv::UMatData *data = new cv::UMatData(allocator);
+    data->data = data->origdata = pixels;
+    data->size = stride * size_t(size.height);
+    data->userdata = new std::shared_ptr<MappedFile>(file);
+    data->refcount = 1;
+    plane.u = data;
+    return plane;
+}
+
+RawStereoFile::RawStereoFile() :
+    stride(0),
+    count(0),
+    rate(0)
+{
+}
+
+bool RawStereoFile::open(const std::string &filename)
+{
+    close();
+    file = std::make_shared<MappedFile>();
+    if (!file->open(filename)) {
+        close();
+        return false;
+    }
+
+    const unsigned char *header = file->bytes();
+    if (file->size() < header_size || std::memcmp(header, magic, sizeof(magic)) != 0 ||
+            get_uint(header + 8, 4) != version) {
+        close();
+        return false;
+    }
+
+    int width = int(get_uint(header + 12, 4));
+    int height = int(get_uint(header + 16, 4));
+    stride = size_t(get_uint(header + 20, 4));
+    unsigned long long frames = get_uint(header + 24, 8);
+    rate = get_double(header + 32);
+
+    // a capture interrupted while being written has fewer frames than its header says
+    size_t frame_bytes = 2 * stride * size_t(height);
+    if (width <= 0 || height <= 0 || stride < size_t(width) || frame_bytes == 0) {
+        close();
+        return false;
+    }
+    unsigned long long available = (file->size() - header_size) / frame_bytes;
+    count = int(std::min(frames, available));
+    frame_size = cv::Size(width, height);
+    return true;
+}
+
+void RawStereoFile::close()
+{
+    file.reset();
+    frame_size = cv::Size();
+    stride = 0;
+    count = 0;
+    rate = 0;
+}
+
+bool RawStereoFile::frame(int index, cv::Mat &left, cv::Mat &right) const
+{
+    if (index < 0 || index >= count)
+        return false;
+
+    size_t plane_bytes = stride * size_t(frame_size.height);
+    unsigned char *data = file->bytes() + header_size + 2 * plane_bytes * size_t(index);
+    left = mapped_plane(file, data, frame_size, stride);
+    right = mapped_plane(file, data + plane_bytes, frame_size, stride);
+    return true;
+}
+
+bool RawStereoFile::is_raw_stereo(const std::string &filename)
+{
+    const std::string extension = ".stereo";
+    return filename.size() > extension.size() &&
+           filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+RawStereoWriter::RawStereoWriter() :
+    file(0),
+    stride(0),
+    rate(0),
+    count(0),
+    failed(false)
+{
+}
+
+RawStereoWriter::~RawStereoWriter()
+{
+    close();
+}
+
+bool RawStereoWriter::open(const std::string &filename, const cv::Size &size, double frame_rate)
+{
+    close();
+    if (size.width <= 0 || size.height <= 0)
+        return false;
+
+    file = std::fopen(filename.c_str(), "wb");
+    if (!file)
+        return false;
+
+    frame_size = size;
+    stride = aligned_stride(size.width);
+    rate = frame_rate;
+    count = 0;
+    failed = !write_header();
+    return !failed;
+}
+
+bool RawStereoWriter::append(const cv::Mat &left, const cv::Mat &right)
+{
+    if (!file || failed || left.size() != frame_size || right.size() != frame_size)
+        return false;
+
+    failed = !write_plane(left) || !write_plane(right);
+    if (!failed)
+        count++;
+    return !failed;
+}
+
+bool RawStereoWriter::close()
+{
+    if (!file)
+        return false;
+
+    bool ok = !failed && std::fseek(file, 0, SEEK_SET) == 0 && write_header();
+    ok = std::fclose(file) == 0 && ok;
+    file = 0;
+    return ok;
+}
+
+bool RawStereoWriter::write_header()
+{
+    std::vector<unsigned char> header(header_size, 0);
+    std::memcpy(&header[0], magic, sizeof(magic));
+    put_uint(&header[8], version, 4);
+    put_uint(&header[12], (unsigned long long)frame_size.width, 4);
+    put_uint(&header[16], (unsigned long long)frame_size.height, 4);
+    put_uint(&header[20], stride, 4);
+    put_uint(&header[24], count, 8);
+    put_double(&header[32], rate);
+    return std::fwrite(&header[0], 1, header.size(), file) == header.size();
+}
+
+bool RawStereoWriter::write_plane(const cv::Mat &image)
+{
+    cv::Mat gray = image;
+    if (image.channels() == 3)
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    if (gray.type() != CV_8UC1)
+        return false;
+
+    std::vector<unsigned char> row(stride, 0);
+    for (int y = 0; y < gray.rows; y++) {
+        std::memcpy(&row[0], gray.ptr(y), size_t(gray.cols));
+        if (std::fwrite(&row[0], 1, stride, file) != stride)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef RAWSTEREO_H
+#define RAWSTEREO_H
+
+#include "opencv2/core/core.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "mappedfile.h"
+
+// a raw stereo capture: rectified 8 bits gray frames, stored uncompressed so that they
+// can be matched straight from a memory mapping, without any decoding
+//
+// layout of a file (little endian):
+//     header (4096 bytes, so that the frames are page aligned):
+//         char     magic[8]      "STEREO8\0"
+//         uint32   version       1
+//         uint32   width
+//         uint32   height
+//         uint32   stride        bytes per row (width rounded up to 64)
+//         uint64   frame_count
+//         float64  frame_rate    0 if unknown
+//     then for each frame: the left plane, then the right plane (height * stride bytes each)
+//
+// the files use the ".stereo" extension
+
+class RawStereoFile
+{
+public:
+    RawStereoFile();
+
+    // we map the file and check its header (the frames are not read)
+    bool open(const std::string &filename);
+    void close();
+    bool is_open() const { return file && file->is_open(); }
+
+    int frame_count() const { return count; }
+    cv::Size size() const { return frame_size; }
+    double frame_rate() const { return rate; }
+
+    // we point the matrices to the planes of a frame, without copying them
+    // (each of them, and each of their copies, keeps the file mapped: it is only unmapped
+    // once the file is closed and the last of them is released)
+    bool frame(int index, cv::Mat &left, cv::Mat &right) const;
+
+    // true if the file name has the extension of the raw captures
+    static bool is_raw_stereo(const std::string &filename);
+
+private:
+    std::shared_ptr<MappedFile> file;  // shared with the frames
+    cv::Size frame_size;
+    size_t stride;
+    int count;
+    double rate;
+};
+
+// we write a raw stereo capture, one frame after the other
+class RawStereoWriter
+{
+public:
+    RawStereoWriter();
+    ~RawStereoWriter();
+
+    bool open(const std::string &filename, const cv::Size &size, double frame_rate = 0);
+
+    // the images must have the size given to open(); color images are converted to gray
+    bool append(const cv::Mat &left, const cv::Mat &right);
+
+    // we write the number of frames in the header
+    bool close();
+
+private:
+    FILE *file;
+    cv::Size frame_size;
+    size_t stride;
+    double rate;
+    unsigned long long count;
+    bool failed;
+
+    bool write_header();
+    bool write_plane(const cv::Mat &image);
+
+    RawStereoWriter(const RawStereoWriter &);
+    RawStereoWriter &operator=(const RawStereoWriter &);
+};
+
+#endif // RAWSTEREO_H
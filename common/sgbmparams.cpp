@@ -0,0 +1,228 @@
+#include "sgbmparams.h"
+
+#include <algorithm>
+#include <sstream>
+
+SGBMParams::SGBMParams() :
+    min_disparity(-16),
+    num_disparities(128),
+    block_size(11),
+    P1(8*11*11),
+    P2(32*11*11),
+    disp12_max_diff(-1),
+    pre_filter_cap(31),
+    uniqueness_ratio(15),
+    speckle_window_size(0),
+    speckle_range(0),
+    mode(0),
+    engine(ENGINE_OPENCV),
+    cost(COST_CENSUS_5X5),
+    wls_lambda(6000),
+    wls_sigma(1.0)
+{
+}
+
+SGBMParams SGBMParams::from_matcher(const cv::Ptr<cv::StereoSGBM> &matcher,
+                                    const cv::Ptr<cv::ximgproc::DisparityWLSFilter> &filter)
+{
+    SGBMParams params;
+    params.min_disparity = matcher->getMinDisparity();
+    params.num_disparities = matcher->getNumDisparities();
+    params.block_size = matcher->getBlockSize();
+    params.P1 = matcher->getP1();
+    params.P2 = matcher->getP2();
+    params.disp12_max_diff = matcher->getDisp12MaxDiff();
+    params.pre_filter_cap = matcher->getPreFilterCap();
+    params.uniqueness_ratio = matcher->getUniquenessRatio();
+    params.speckle_window_size = matcher->getSpeckleWindowSize();
+    params.speckle_range = matcher->getSpeckleRange();
+    params.mode = matcher->getMode();
+
+    if (filter) {
+        params.wls_lambda = filter->getLambda();
+        params.wls_sigma = filter->getSigmaColor();
+    }
+    return params;
+}
+
+void SGBMParams::apply_to(const cv::Ptr<cv::StereoSGBM> &matcher) const
+{
+    matcher->setMinDisparity(min_disparity);
+    matcher->setNumDisparities(num_disparities);
+    matcher->setBlockSize(block_size);
+    matcher->setP1(P1);
+    matcher->setP2(P2);
+    matcher->setDisp12MaxDiff(disp12_max_diff);
+    matcher->setPreFilterCap(pre_filter_cap);
+    matcher->setUniquenessRatio(uniqueness_ratio);
+    matcher->setSpeckleWindowSize(speckle_window_size);
+    matcher->setSpeckleRange(speckle_range);
+    matcher->setMode(mode);
+}
+
+void SGBMParams::apply_to(const cv::Ptr<cv::ximgproc::DisparityWLSFilter> &filter) const
+{
+    filter->setLambda(wls_lambda);
+    filter->setSigmaColor(wls_sigma);
+}
+
+cv::Ptr<cv::StereoSGBM> SGBMParams::create_matcher() const
+{
+    cv::Ptr<cv::StereoSGBM> matcher = cv::StereoSGBM::create(min_disparity, num_disparities, block_size);
+    apply_to(matcher);
+    return matcher;
+}
+
+SGBMParams SGBMParams::scaled(int factor) const
+{
+    SGBMParams params = *this;
+    if (factor <= 1)
+        return params;
+
+    params.min_disparity = min_disparity / factor;
+
+    // the number of disparities must stay a non-zero multiple of 16
+    params.num_disparities = std::max(16, ((num_disparities / factor + 15) / 16) * 16);
+
+    // the block size must stay odd
+    params.block_size = std::max(3, (block_size / factor) | 1);
+
+    // P1 and P2 are usually proportional to the area of the block
+    double area_ratio = double(params.block_size * params.block_size) / (block_size * block_size);
+    params.P1 = std::max(1, int(P1 * area_ratio));
+    params.P2 = std::max(params.P1 + 1, int(P2 * area_ratio));
+
+    params.speckle_window_size = speckle_window_size / (factor * factor);
+    if (speckle_range > 0)
+        params.speckle_range = std::max(1, speckle_range / factor);
+    if (disp12_max_diff > 0)
+        params.disp12_max_diff = std::max(1, disp12_max_diff / factor);
+
+    return params;
+}
+
+SGBMParams SGBMParams::right_view() const
+{
+    SGBMParams params = *this;
+    params.min_disparity = -(min_disparity + num_disparities) + 1;
+    params.uniqueness_ratio = 0;
+    params.disp12_max_diff = 1000000;
+    params.speckle_window_size = 0;
+    params.speckle_range = 0;
+    return params;
+}
+
+SGBMParams SGBMParams::raw_matching() const
+{
+    SGBMParams params = *this;
+    params.speckle_window_size = 0;
+    params.speckle_range = 0;
+    return params;
+}
+
+bool SGBMParams::same_matching(const SGBMParams &other) const
+{
+    return min_disparity == other.min_disparity &&
+           num_disparities == other.num_disparities &&
+           block_size == other.block_size &&
+           P1 == other.P1 &&
+           P2 == other.P2 &&
+           disp12_max_diff == other.disp12_max_diff &&
+           pre_filter_cap == other.pre_filter_cap &&
+           uniqueness_ratio == other.uniqueness_ratio &&
+           speckle_window_size == other.speckle_window_size &&
+           speckle_range == other.speckle_range &&
+           mode == other.mode &&
+           engine == other.engine &&
+           cost == other.cost;
+}
+
+std::string SGBMParams::matching_key() const
+{
+    std::ostringstream stream;
+    stream << min_disparity << " " << num_disparities << " " << block_size << " "
+           << P1 << " " << P2 << " " << disp12_max_diff << " " << pre_filter_cap << " "
+           << uniqueness_ratio << " " << speckle_window_size << " " << speckle_range << " " << mode << " " << engine << " " << cost;
+    return stream.str();
+}
+
+std::string SGBMParams::key() const
+{
+    std::ostringstream stream;
+    stream.precision(17);
+    stream << matching_key() << " " << wls_lambda << " " << wls_sigma;
+    return stream.str();
+}
+
+void SGBMParams::write(cv::FileStorage &fs) const
+{
+    fs << "min_disparity" << min_disparity;
+    fs << "num_disparities" << num_disparities;
+    fs << "block_size" << block_size;
+    fs << "P1" << P1;
+    fs << "P2" << P2;
+    fs << "disp12_max_diff" << disp12_max_diff;
+    fs << "pre_filter_cap" << pre_filter_cap;
+    fs << "uniqueness_ratio" << uniqueness_ratio;
+    fs << "speckle_window_size" << speckle_window_size;
+    fs << "speckle_range" << speckle_range;
+    fs << "mode" << mode;
+    fs << "engine" << engine;
+    fs << "cost" << cost;
+    fs << "wls_lambda" << wls_lambda;
+    fs << "wls_sigma" << wls_sigma;
+}
+
+// we only overwrite the value if the file defines it
+template <typename T>
+static void read_value(const cv::FileNode &node, const char *name, T &value)
+{
+    if (!node[name].empty())
+        node[name] >> value;
+}
+
+SGBMParams SGBMParams::read(const cv::FileNode &node)
+{
+    SGBMParams params;
+    read_value(node, "min_disparity", params.min_disparity);
+    read_value(node, "num_disparities", params.num_disparities);
+    read_value(node, "block_size", params.block_size);
+    read_value(node, "P1", params.P1);
+    read_value(node, "P2", params.P2);
+    read_value(node, "disp12_max_diff", params.disp12_max_diff);
+    read_value(node, "pre_filter_cap", params.pre_filter_cap);
+    read_value(node, "uniqueness_ratio", params.uniqueness_ratio);
+    read_value(node, "speckle_window_size", params.speckle_window_size);
+    read_value(node, "speckle_range", params.speckle_range);
+    read_value(node, "mode", params.mode);
+    read_value(node, "engine", params.engine);
+    read_value(node, "cost", params.cost);
+    read_value(node, "wls_lambda", params.wls_lambda);
+    read_value(node, "wls_sigma", params.wls_sigma);
+    return params;
+}
+
+bool SGBMParams::save(const std::string &filename) const
+{
+    cv::FileStorage fs(filename, cv::FileStorage::WRITE);
+    if (!fs.isOpened())
+        return false;
+    write(fs);
+    return true;
+}
+
+bool SGBMParams::load(const std::string &filename, SGBMParams &params)
+{
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    if (!fs.isOpened())
+        return false;
+    params = read(fs.root());
+    return true;
+}
+
+bool SGBMParams::operator==(const SGBMParams &other) const
+{
+    return same_matching(other) &&
+           wls_lambda == other.wls_lambda &&
+           wls_sigma == other.wls_sigma;
+}
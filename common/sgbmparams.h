@@ -0,0 +1,98 @@
+#ifndef SGBMPARAMS_H
+#define SGBMPARAMS_H
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/ximgproc/disparity_filter.hpp"
+
+#include <string>
+
+// an immutable snapshot of all the parameters of the semi-global block-matching
+// algorithm and of the wls-filter
+// the GUI builds one of these every time a slider changes, and hands it over to
+// the code that actually computes the depth map (possibly in another thread),
+// so that the computation never reads parameters that are being modified
+struct SGBMParams
+{
+    int min_disparity;
+    int num_disparities;      // must be > 0 and divisible by 16
+    int block_size;           // must be odd
+    int P1;
+    int P2;                   // must be > P1
+    int disp12_max_diff;
+    int pre_filter_cap;
+    int uniqueness_ratio;
+    int speckle_window_size;
+    int speckle_range;
+    int mode;                 // one of cv::StereoSGBM::MODE_*
+    int engine;               // one of the ENGINE_* below
+    int cost;                 // one of the COST_* below
+
+    double wls_lambda;
+    double wls_sigma;
+
+    // the implementation of the matching: cv::StereoSGBM, or the SGM engine of the
+    // tuner (see sgmengine.h), which reads the same parameters
+    enum {
+        ENGINE_OPENCV = 0,
+        ENGINE_SGM = 1
+    };
+
+    // the pixel matching cost of the SGM engine (see sgmcosts.h); cv::StereoSGBM always
+    // compares its pre-filtered images with the dissimilarity of Birchfield and Tomasi
+    enum {
+        COST_CENSUS_5X5 = 0,
+        COST_CENSUS_7X9 = 1,
+        COST_RANK = 2,
+        COST_BIRCHFIELD_TOMASI = 3,
+        COST_ZSAD = 4,
+        COST_COUNT
+    };
+
+    // the default values are the ones used by the tuner at startup
+    SGBMParams();
+
+    // we read the parameters currently held by the OpenCV objects
+    static SGBMParams from_matcher(const cv::Ptr<cv::StereoSGBM> &matcher,
+                                   const cv::Ptr<cv::ximgproc::DisparityWLSFilter> &filter);
+
+    // we write the parameters into existing OpenCV objects
+    void apply_to(const cv::Ptr<cv::StereoSGBM> &matcher) const;
+    void apply_to(const cv::Ptr<cv::ximgproc::DisparityWLSFilter> &filter) const;
+
+    // we create a new matcher configured with these parameters
+    // (always a cv::StereoSGBM, which the wls-filter also reads its parameters from)
+    cv::Ptr<cv::StereoSGBM> create_matcher() const;
+
+    // the equivalent parameters for images downscaled by the given factor
+    // (disparities and block size shrink with the image, and P1/P2 follow the block area)
+    SGBMParams scaled(int factor) const;
+
+    // the parameters of the matcher computing the disparity of the right view
+    // (same as cv::ximgproc::createRightMatcher, but without creating a new matcher)
+    SGBMParams right_view() const;
+
+    // the parameters of the matcher without its speckle filter (see post_process() in
+    // stereomatch.h), which only depends on the raw disparity; the left-right check stays in
+    // the matcher, which checks both views from its own costs
+    SGBMParams raw_matching() const;
+
+    // true if both snapshots produce the same raw disparity (the wls parameters are ignored)
+    bool same_matching(const SGBMParams &other) const;
+
+    // the parameters as a string, to identify the results they produce in a cache
+    // (matching_key() ignores the wls parameters, like same_matching())
+    std::string matching_key() const;
+    std::string key() const;
+
+    // parameter files (YAML or XML, through cv::FileStorage), shared by the tuner and the
+    // command-line tools; the parameters missing from a file keep their default value
+    void write(cv::FileStorage &fs) const;
+    static SGBMParams read(const cv::FileNode &node);
+    bool save(const std::string &filename) const;
+    static bool load(const std::string &filename, SGBMParams &params);
+
+    bool operator==(const SGBMParams &other) const;
+    bool operator!=(const SGBMParams &other) const { return !(*this == other); }
+};
+
+#endif // SGBMPARAMS_H
@@ -0,0 +1,343 @@
+#include "sgmcosts.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+// the rows of a window around row y, extended by radius_x columns on each side (the image is
+// extended by replicating its borders), so that the transforms read them without checks
+static void window_rows(const cv::Mat &image, int y, int radius_x, int radius_y, std::vector<uchar> &rows)
+{
+    const int width = image.cols;
+    const int stride = width + 2 * radius_x;
+    rows.resize(size_t(2 * radius_y + 1) * stride);
+    for (int dy = -radius_y; dy <= radius_y; dy++) {
+        const uchar *source = image.ptr<uchar>(std::min(image.rows - 1, std::max(0, y + dy)));
+        uchar *row = &rows[size_t(dy + radius_y) * stride];
+        std::fill(row, row + radius_x, source[0]);
+        std::copy(source, source + width, row + radius_x);
+        std::fill(row + radius_x + width, row + stride, source[width - 1]);
+    }
+}
+
+// a transformed row of the right image, reversed, with room on both sides for the candidates
+// falling outside of the image (their costs are replaced by the highest one)
+template <typename T>
+class ReversedRow
+{
+public:
+    ReversedRow() : width(0), min_disparity(0), disparities(0), offset(0) {}
+
+    void set(const T *row, int width, int min_disparity, int disparities)
+    {
+        if (width != this->width || min_disparity != this->min_disparity || disparities != this->disparities) {
+            this->width = width;
+            this->min_disparity = min_disparity;
+            this->disparities = disparities;
+            offset = -std::min(0, min_disparity);
+            values.assign(offset + std::max(width, width + min_disparity + disparities - 1), T());
+        }
+        std::reverse_copy(row, row + width, &values[offset]);
+    }
+
+    // the candidates of the left pixel x, for the disparities 0 to disparities - 1
+    const T *candidates(int x) const { return &values[offset + width - 1 - x + min_disparity]; }
+
+private:
+    int width;
+    int min_disparity;
+    int disparities;
+    int offset;
+    std::vector<T> values;
+};
+
+// the disparities of the left pixel x whose match is inside the right image
+static inline void valid_disparities(int x, int width, int min_disparity, int disparities, int &first, int &last)
+{
+    first = std::max(0, x - min_disparity - (width - 1));
+    last = std::min(disparities - 1, x - min_disparity);
+}
+
+static inline void invalidate(uint8_t *costs, int disparities, int first, int last, int highest_cost)
+{
+    std::fill(costs, costs + std::max(0, std::min(first, disparities)), uint8_t(highest_cost));
+    std::fill(costs + std::max(0, last + 1), costs + disparities, uint8_t(highest_cost));
+}
+
+// the census transforms, in one or two words of 32 bits
+class CensusCost : public MatchingCost
+{
+public:
+    CensusCost(int radius_x, int radius_y, SimdIsa isa) :
+        MatchingCost((2 * radius_x + 1) * (2 * radius_y + 1) - 1),
+        radius_x(radius_x),
+        radius_y(radius_y),
+        words((highest_cost + 31) / 32),
+        hamming(hamming_kernel(isa))
+    {
+    }
+
+    void row_costs(const cv::Mat &left, const cv::Mat &right, int y, int min_disparity,
+                   int disparities, uint8_t *costs)
+    {
+        const int width = left.cols;
+        transform(right, y);
+        for (int w = 0; w < words; w++)
+            right_words[w].set(&bits[w][0], width, min_disparity, disparities);
+        transform(left, y);
+
+        for (int x = 0; x < width; x++) {
+            uint8_t *out = costs + size_t(x) * disparities;
+            int first, last;
+            valid_disparities(x, width, min_disparity, disparities, first, last);
+            if (first <= last)
+                for (int w = 0; w < words; w++)
+                    hamming(bits[w][x], right_words[w].candidates(x), out, disparities, w > 0);
+            invalidate(out, disparities, first, last, highest_cost);
+        }
+    }
+
+private:
+    int radius_x;
+    int radius_y;
+    int words;
+    HammingKernel hamming;
+    std::vector<uchar> rows;
+    std::vector<uint32_t> bits[2];
+    ReversedRow<uint32_t> right_words[2];
+
+    void transform(const cv::Mat &image, int y)
+    {
+        const int width = image.cols;
+        const int stride = width + 2 * radius_x;
+        window_rows(image, y, radius_x, radius_y, rows);
+        for (int w = 0; w < words; w++)
+            bits[w].resize(width);
+
+        for (int x = 0; x < width; x++) {
+            const uchar center = rows[size_t(radius_y) * stride + x + radius_x];
+            uint64_t census = 0;
+            for (int dy = 0; dy <= 2 * radius_y; dy++) {
+                const uchar *row = &rows[size_t(dy) * stride + x];
+                for (int dx = 0; dx <= 2 * radius_x; dx++) {
+                    if (dy == radius_y && dx == radius_x)
+                        continue;
+                    census = (census << 1) | (row[dx] < center);
+                }
+            }
+            bits[0][x] = uint32_t(census);
+            if (words > 1)
+                bits[1][x] = uint32_t(census >> 32);
+        }
+    }
+};
+
+// the costs comparing intervals of intensities (an interval of a single value for the
+// absolute difference), each transform giving the values and the bounds of the intervals
+class IntervalCost : public MatchingCost
+{
+public:
+    void row_costs(const cv::Mat &left, const cv::Mat &right, int y, int min_disparity,
+                   int disparities, uint8_t *costs)
+    {
+        const int width = left.cols;
+        values.resize(width);
+        minimums.resize(width);
+        maximums.resize(width);
+        transform(right, y);
+        right_values.set(&values[0], width, min_disparity, disparities);
+        right_minimums.set(&minimums[0], width, min_disparity, disparities);
+        right_maximums.set(&maximums[0], width, min_disparity, disparities);
+        transform(left, y);
+
+        for (int x = 0; x < width; x++) {
+            uint8_t *out = costs + size_t(x) * disparities;
+            int first, last;
+            valid_disparities(x, width, min_disparity, disparities, first, last);
+            if (first <= last)
+                interval(values[x], minimums[x], maximums[x], right_values.candidates(x),
+                         right_minimums.candidates(x), right_maximums.candidates(x), out, disparities);
+            invalidate(out, disparities, first, last, highest_cost);
+        }
+    }
+
+protected:
+    IntervalCost(int highest_cost, SimdIsa isa) :
+        MatchingCost(highest_cost),
+        interval(interval_kernel(isa))
+    {
+    }
+
+    std::vector<uint8_t> values;
+    std::vector<uint8_t> minimums;
+    std::vector<uint8_t> maximums;
+
+    // we fill values, minimums and maximums for row y of image
+    virtual void transform(const cv::Mat &image, int y) = 0;
+
+private:
+    IntervalKernel interval;
+    ReversedRow<uint8_t> right_values;
+    ReversedRow<uint8_t> right_minimums;
+    ReversedRow<uint8_t> right_maximums;
+};
+
+class RankCost : public IntervalCost
+{
+public:
+    explicit RankCost(SimdIsa isa) : IntervalCost((2 * radius + 1) * (2 * radius + 1) - 1, isa) {}
+
+private:
+    static const int radius = 3;
+    std::vector<uchar> rows;
+
+    void transform(const cv::Mat &image, int y)
+    {
+        const int width = image.cols;
+        const int stride = width + 2 * radius;
+        window_rows(image, y, radius, radius, rows);
+        for (int x = 0; x < width; x++) {
+            const uchar center = rows[size_t(radius) * stride + x + radius];
+            int rank = 0;
+            for (int dy = 0; dy <= 2 * radius; dy++) {
+                const uchar *row = &rows[size_t(dy) * stride + x];
+                for (int dx = 0; dx <= 2 * radius; dx++)
+                    rank += row[dx] < center;
+            }
+            values[x] = minimums[x] = maximums[x] = uint8_t(rank);
+        }
+    }
+};
+
+// the interval of a pixel goes from its intensity to the ones half-way to its neighbours
+class BirchfieldTomasiCost : public IntervalCost
+{
+public:
+    explicit BirchfieldTomasiCost(SimdIsa isa) : IntervalCost(255, isa) {}
+
+private:
+    void transform(const cv::Mat &image, int y)
+    {
+        const int width = image.cols;
+        const uchar *row = image.ptr<uchar>(y);
+        for (int x = 0; x < width; x++) {
+            int value = row[x];
+            int before = (value + row[std::max(0, x - 1)]) / 2;
+            int after = (value + row[std::min(width - 1, x + 1)]) / 2;
+            values[x] = uint8_t(value);
+            minimums[x] = uint8_t(std::min(value, std::min(before, after)));
+            maximums[x] = uint8_t(std::max(value, std::max(before, after)));
+        }
+    }
+};
+
+// the mean of the block around each pixel is the sum of the columns of the block, computed
+// for the whole row, then slid along it
+class ZeroMeanCost : public IntervalCost
+{
+public:
+    ZeroMeanCost(int block_size, int cap, SimdIsa isa) :
+        IntervalCost(2 * std::max(1, cap), isa),
+        radius(block_size / 2),
+        cap(std::max(1, cap))
+    {
+    }
+
+private:
+    int radius;
+    int cap;
+    std::vector<uchar> rows;
+    std::vector<int> column_sums;
+
+    void transform(const cv::Mat &image, int y)
+    {
+        const int width = image.cols;
+        const int stride = width + 2 * radius;
+        const int side = 2 * radius + 1;
+        const int area = side * side;
+        window_rows(image, y, radius, radius, rows);
+
+        column_sums.assign(stride, 0);
+        for (int dy = 0; dy < side; dy++) {
+            const uchar *row = &rows[size_t(dy) * stride];
+            for (int x = 0; x < stride; x++)
+                column_sums[x] += row[x];
+        }
+
+        const uchar *center_row = &rows[size_t(radius) * stride + radius];
+        int block_sum = 0;
+        for (int x = 0; x < side - 1; x++)
+            block_sum += column_sums[x];
+        for (int x = 0; x < width; x++) {
+            block_sum += column_sums[x + side - 1];
+            int mean = (block_sum + area / 2) / area;
+            int value = std::min(cap, std::max(-cap, center_row[x] - mean)) + cap;
+            values[x] = minimums[x] = maximums[x] = uint8_t(value);
+            block_sum -= column_sums[x];
+        }
+    }
+};
+
+cv::Ptr<MatchingCost> MatchingCost::create(const SGBMParams &params, SimdIsa isa)
+{
+    switch (params.cost) {
+    case SGBMParams::COST_CENSUS_5X5:
+        return cv::Ptr<MatchingCost>(new CensusCost(2, 2, isa));
+    case SGBMParams::COST_CENSUS_7X9:
+        return cv::Ptr<MatchingCost>(new CensusCost(4, 3, isa));
+    case SGBMParams::COST_RANK:
+        return cv::Ptr<MatchingCost>(new RankCost(isa));
+    case SGBMParams::COST_BIRCHFIELD_TOMASI:
+        return cv::Ptr<MatchingCost>(new BirchfieldTomasiCost(isa));
+    case SGBMParams::COST_ZSAD:
+        return cv::Ptr<MatchingCost>(new ZeroMeanCost(params.block_size, params.pre_filter_cap, isa));
+    default:
+        CV_Error(cv::Error::StsOutOfRange, "unknown matching cost");
+    }
+    return cv::Ptr<MatchingCost>();
+}
+
+bool MatchingCost::same_cost(const SGBMParams &a, const SGBMParams &b)
+{
+    if (a.cost != b.cost)
+        return false;
+    if (a.cost == SGBMParams::COST_ZSAD)
+        return a.block_size == b.block_size && a.pre_filter_cap == b.pre_filter_cap;
+    return true;
+}
+
+size_t MatchingCost::buffer_size(const SGBMParams &params, int width)
+{
+    // the right row reversed, with room for the candidates outside of the image
+    const size_t W = std::max(0, width);
+    const size_t reversed = W + std::max(0, params.num_disparities) + std::abs(params.min_disparity);
+    switch (params.cost) {
+    case SGBMParams::COST_CENSUS_5X5:
+        return 5 * (W + 4) + (W + reversed) * sizeof(uint32_t);
+    case SGBMParams::COST_CENSUS_7X9:
+        return 7 * (W + 8) + 2 * (W + reversed) * sizeof(uint32_t);
+    case SGBMParams::COST_RANK:
+        return 7 * (W + 6) + 3 * (W + reversed);
+    case SGBMParams::COST_ZSAD: {
+        const size_t side = std::max(1, params.block_size);
+        return side * (W + side) + (W + side) * sizeof(int) + 3 * (W + reversed);
+    }
+    default:
+        return 3 * (W + reversed);
+    }
+}
+
+static const char *const cost_names[SGBMParams::COST_COUNT] = { "census5x5", "census7x9", "rank", "bt", "zsad" };
+
+const char *MatchingCost::name(int cost)
+{
+    return cost >= 0 && cost < SGBMParams::COST_COUNT ? cost_names[cost] : "unknown";
+}
+
+int MatchingCost::from_name(const std::string &name)
+{
+    for (int cost = 0; cost < SGBMParams::COST_COUNT; cost++)
+        if (name == cost_names[cost])
+            return cost;
+    return -1;
+}
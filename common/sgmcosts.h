@@ -0,0 +1,67 @@
+#ifndef SGMCOSTS_H
+#define SGMCOSTS_H
+
+#include "opencv2/core/core.hpp"
+
+#include <stdint.h>
+#include <string>
+
+#include "sgbmparams.h"
+#include "sgmkernels.h"
+
+// the pixel matching costs of the SGM engine (see SGBMParams::cost)
+//
+// each cost transforms a row of both images, then compares each pixel of the left row with
+// the pixels of the right row it may match, with the SIMD kernels of sgmkernels.h:
+// - census 5x5 and 7x9 (rows x columns): the bits of the neighbours darker than the pixel,
+//   compared with the Hamming distance (24 and 62 bits)
+// - rank: the number of the neighbours darker than the pixel in a 7x7 window, compared with
+//   the absolute difference
+// - Birchfield-Tomasi: the intensities, compared with the dissimilarity of Birchfield and
+//   Tomasi, insensitive to the sampling of the images
+// - zero-mean SAD: the intensities minus their mean over the block, truncated to the
+//   pre-filter cap, compared with the absolute difference (the mean is the one of the block
+//   around each pixel, not around the pixel it is matched with, so that the engine can sum
+//   the costs over the block)
+// census and rank only depend on the order of the intensities, so they resist differences
+// of gain between the cameras; zero-mean SAD resists differences of offset, and
+// Birchfield-Tomasi neither, but keeps the most texture
+// the transforms of the right row are stored reversed, so that the candidates of a left
+// pixel are contiguous for increasing disparities; the buffers are kept between two rows,
+// a cost must only be used by one thread at a time
+class MatchingCost
+{
+public:
+    virtual ~MatchingCost() {}
+
+    // the cost of the worst match, also given to the pixels matched outside of the right image
+    int max_cost() const { return highest_cost; }
+
+    // costs[x * disparities + d] is the cost of matching the pixel x of row y of left with the
+    // pixel x - (min_disparity + d) of the same row of right (CV_8UC1 images of the same
+    // size); disparities is a multiple of 16
+    virtual void row_costs(const cv::Mat &left, const cv::Mat &right, int y, int min_disparity,
+                           int disparities, uint8_t *costs) = 0;
+
+    // the cost of these parameters, with the kernels of an instruction set (which must be
+    // supported); a cv::Exception is thrown for an unknown cost
+    static cv::Ptr<MatchingCost> create(const SGBMParams &params, SimdIsa isa);
+
+    // true if both parameters give the same costs (the cost, and the parameters it reads)
+    static bool same_cost(const SGBMParams &a, const SGBMParams &b);
+
+    // the memory of the buffers of the cost of these parameters, for images of this width
+    static size_t buffer_size(const SGBMParams &params, int width);
+
+    // the name of a cost on the command line and in the results ("census5x5", "census7x9",
+    // "rank", "bt", "zsad"), and the cost of a name (-1 if unknown)
+    static const char *name(int cost);
+    static int from_name(const std::string &name);
+
+protected:
+    explicit MatchingCost(int highest_cost) : highest_cost(highest_cost) {}
+
+    int highest_cost;
+};
+
+#endif // SGMCOSTS_H
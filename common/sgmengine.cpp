@@ -0,0 +1,672 @@
+#include "sgmengine.h"
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+
+// true if both images have the same size and pixels
+static bool same_image(const cv::Mat &a, const cv::Mat &b)
+{
+    if (a.size() != b.size() || a.type() != b.type())
+        return false;
+    for (int y = 0; y < a.rows; y++)
+        if (std::memcmp(a.ptr<uchar>(y), b.ptr<uchar>(y), a.cols) != 0)
+            return false;
+    return true;
+}
+
+SGMEngine::SGMEngine() :
+    limit(0),
+    width(0),
+    height(0),
+    disparities(0),
+    min_disparity(0),
+    block_radius(0),
+    cost_shift(0),
+    P1(0),
+    P2(0),
+    band_rows(0),
+    first_summed_row(0),
+    last_summed_row(-1),
+    volume_budget(size_t(DEFAULT_COST_VOLUME_BUDGET_MB) << 20),
+    keep_volume(false),
+    volume_reused(false),
+    volume_rows(0),
+    block_costs_kernel(&SGMEngine::block_costs_loop<0, -1>),
+    select_kernel(&SGMEngine::select_loop<0>)
+{
+    set_isa(best_simd_isa());
+}
+
+void SGMEngine::set_isa(SimdIsa isa)
+{
+    simd_isa = simd_isa_supported(isa) ? isa : SIMD_SCALAR;
+    aggregate = aggregate_kernel(simd_isa);
+    matching_cost.release();  // its kernels are the ones of the previous instruction set
+}
+
+void SGMEngine::set_cost_volume_budget(size_t bytes)
+{
+    volume_budget = bytes;
+}
+
+size_t SGMEngine::cost_volume_size(const cv::Size &size, const SGBMParams &params)
+{
+    return size_t(size.width) * size.height * std::max(0, params.num_disparities) * sizeof(uint16_t);
+}
+
+void SGMEngine::set_memory_limit(size_t bytes)
+{
+    limit = bytes;
+}
+
+// the buffers of compute(), in bytes: the ones of any computation, the cost volume (with
+// the copies of the images it was computed from), then the aggregation with 5 paths, or
+// with 8 paths in one piece or in bands
+SGMEngine::MemoryEstimate SGMEngine::estimate_memory(const cv::Size &size, const SGBMParams &params,
+                                                     size_t memory_limit, size_t cost_volume_budget)
+{
+    const size_t W = std::max(0, size.width), H = std::max(0, size.height);
+    const size_t D = std::max(0, params.num_disparities), S = D + 2;
+    const size_t block = std::max(1, params.block_size);
+    const bool eight_paths = path_count(params.mode) == 8;
+    const size_t row = W * D * sizeof(uint16_t);
+    const size_t checkpoint = 3 * (W * S + W) * sizeof(uint16_t);
+
+    size_t fixed = (block + 1) * W * D      // pixel_cost_rows
+                 + 2 * row                  // column_sums, costs
+                 + D * sizeof(uint32_t)     // block_sum
+                 + MatchingCost::buffer_size(params, size.width)
+                 + 3 * S * sizeof(uint16_t) // start_path, horizontal_paths
+                 + W * (sizeof(uint16_t) + sizeof(int))  // right_costs, right_disparities
+                 + (eight_paths ? 2 : 1) * 6 * W * (S + 1) * sizeof(uint16_t);  // vertical paths
+    if (params.speckle_window_size > 0)
+        fixed += W * H * 9;  // the buffer of cv::filterSpeckles
+    const size_t volume = cost_volume_size(size, params) + 2 * W * H;
+
+    // the option of least memory, used when none fits under the limit
+    MemoryEstimate least;
+    least.peak_bytes = std::numeric_limits<size_t>::max();
+
+    for (int with_volume = 1; with_volume >= 0; with_volume--) {
+        if (with_volume && cost_volume_size(size, params) > cost_volume_budget)
+            continue;
+        size_t base = fixed + (with_volume ? volume : 0);
+        MemoryEstimate estimate;
+        estimate.keeps_cost_volume = with_volume;
+        estimate.band_rows = int(H);
+        if (!eight_paths) {
+            estimate.peak_bytes = base + row;
+        } else {
+            // in one piece, or else the largest band whose sums (and costs, without volume)
+            // fit with the checkpoints; when none fits, the band of least memory (the
+            // checkpoints grow as the bands shrink)
+            estimate.peak_bytes = base + H * row;
+            if (memory_limit != 0 && estimate.peak_bytes > memory_limit) {
+                const size_t per_row = with_volume ? row : 2 * row;
+                int fitting_rows = 0;
+                int least_rows = int(H);
+                size_t least_peak = estimate.peak_bytes;
+                for (int rows = 1; rows < int(H); rows++) {
+                    size_t peak = base + rows * per_row + (H + rows - 1) / rows * checkpoint;
+                    if (peak <= memory_limit)
+                        fitting_rows = rows;
+                    if (peak < least_peak) {
+                        least_peak = peak;
+                        least_rows = rows;
+                    }
+                }
+                estimate.band_rows = fitting_rows > 0 ? fitting_rows : least_rows;
+                estimate.peak_bytes = estimate.band_rows < int(H) ?
+                            base + estimate.band_rows * per_row +
+                            (H + estimate.band_rows - 1) / estimate.band_rows * checkpoint :
+                            least_peak;
+            }
+        }
+        estimate.fits = memory_limit == 0 || estimate.peak_bytes <= memory_limit;
+        if (estimate.fits)
+            return estimate;
+        if (estimate.peak_bytes < least.peak_bytes)
+            least = estimate;
+    }
+    return least;
+}
+
+int SGMEngine::path_count(int mode)
+{
+    return mode == cv::StereoSGBM::MODE_HH ? 8 : 5;
+}
+
+// we resize a buffer, releasing the memory it no longer needs (under a memory limit, the
+// buffers of a previous computation on larger images must not stay allocated)
+template <typename T>
+static void fit(std::vector<T> &buffer, size_t size)
+{
+    if (buffer.capacity() > size)
+        std::vector<T>(size).swap(buffer);
+    else
+        buffer.resize(size);
+}
+
+void SGMEngine::compute(const SGBMParams &params, const cv::Mat &left, const cv::Mat &right, cv::Mat &disparity)
+{
+    CV_Assert(left.type() == CV_8UC1 && right.type() == CV_8UC1 && left.size() == right.size());
+    if (params.num_disparities <= 0 || params.num_disparities % 16 != 0)
+        CV_Error(cv::Error::StsOutOfRange, "the number of disparities must be a positive multiple of 16");
+    if (params.block_size < 1 || params.block_size % 2 == 0)
+        CV_Error(cv::Error::StsOutOfRange, "the block size must be odd");
+
+    if (matching_cost.empty() || !MatchingCost::same_cost(params, cost_params)) {
+        matching_cost = MatchingCost::create(params, simd_isa);
+        cost_params = params;
+    }
+
+    // under a limit too low, we use as little memory as we can (see estimate_memory())
+    MemoryEstimate estimate = estimate_memory(left.size(), params, limit, volume_budget);
+
+    width = left.cols;
+    height = left.rows;
+    disparities = params.num_disparities;
+    min_disparity = params.min_disparity;
+    block_radius = params.block_size / 2;
+    band_rows = estimate.band_rows;
+    choose_loops();
+
+    // a block cost is at most the highest pixel cost times the pixels of the block; we keep
+    // it under 2^13, so that the sums of the paths rarely saturate
+    int block_rows = std::min(params.block_size, height);
+    int block_columns = std::min(params.block_size, width);
+    cost_shift = 0;
+    while ((matching_cost->max_cost() * block_rows * block_columns) >> cost_shift >= (1 << 13))
+        cost_shift++;
+    P1 = uint16_t(std::min(0xffff, std::max(1, params.P1 >> cost_shift)));
+    P2 = uint16_t(std::min(0xffff, std::max(int(P1), params.P2 >> cost_shift)));
+
+    const int paths = path_count(params.mode);
+    const bool in_bands = paths == 8 && band_rows < height;
+    const int stride = disparities + 2;
+    const size_t row_size = size_t(width) * disparities;
+    try {
+        prepare_volume(params, left, right, estimate.keeps_cost_volume);
+
+        fit(pixel_cost_rows, (params.block_size + 1) * row_size);
+        fit(column_sums, row_size);
+        std::fill(column_sums.begin(), column_sums.end(), 0);
+        fit(block_sum, disparities);
+        fit(costs, row_size);
+        fit(band_costs, in_bands && !keep_volume ? band_rows * row_size : 0);
+        first_summed_row = 0;
+        last_summed_row = -1;
+
+        // with 8 paths, the sums of the paths going down are kept for the paths going up
+        fit(sums, paths == 8 ? band_rows * row_size : row_size);
+        fit(checkpoints, in_bands ? (height + band_rows - 1) / band_rows * 3 * (size_t(width) * stride + width) : 0);
+
+        fit(start_path, stride);
+        std::fill(start_path.begin(), start_path.end(), 0);
+        start_path.front() = start_path.back() = 0xffff;
+        fit(horizontal_paths, 2 * stride);
+        std::fill(horizontal_paths.begin(), horizontal_paths.end(), 0xffff);
+        reset_paths(down_paths, true);
+        reset_paths(up_paths, paths == 8);
+        fit(right_costs, width);
+        fit(right_disparities, width);
+    } catch (const std::bad_alloc &) {
+        CV_Error(cv::Error::StsNoMemory, "not enough memory for the SGM engine with these images and parameters");
+    }
+
+    left_image = left;
+    right_image = right;
+    disparity.create(height, width, CV_16SC1);
+    if (paths != 8)
+        aggregate_single_pass(params, disparity);
+    else if (!in_bands)
+        aggregate_whole(params, disparity);
+    else
+        aggregate_bands(params, disparity);
+    left_image.release();
+    right_image.release();
+
+    // the same post-processing as cv::StereoSGBM::compute()
+    if (params.speckle_window_size > 0)
+        cv::filterSpeckles(disparity, (min_disparity - 1) * cv::StereoMatcher::DISP_SCALE,
+                           params.speckle_window_size, cv::StereoMatcher::DISP_SCALE * params.speckle_range,
+                           speckle_buffer);
+    else
+        speckle_buffer.release();
+}
+
+// 5 paths: the paths from the left, from the right and from the row above, then the
+// disparities are selected row by row
+void SGMEngine::aggregate_single_pass(const SGBMParams &params, cv::Mat &disparity)
+{
+    for (int y = 0; y < height; y++) {
+        const uint16_t *cost_row = row_costs(y);
+        std::fill(sums.begin(), sums.end(), 0);
+        aggregate_row(cost_row, y == 0, &sums[0], true, true, down_paths);
+        select_disparities(params, &sums[0], disparity.ptr<short>(y));
+    }
+}
+
+// 8 paths in one piece: down the image, the paths from the left and from the row above,
+// whose sums are kept for the whole image; then up the image, the paths from the right and
+// from the row below
+void SGMEngine::aggregate_whole(const SGBMParams &params, cv::Mat &disparity)
+{
+    const size_t row_size = size_t(width) * disparities;
+    for (int y = 0; y < height; y++) {
+        const uint16_t *cost_row = row_costs(y);
+        uint16_t *row_sums = &sums[y * row_size];
+        std::fill(row_sums, row_sums + row_size, 0);
+        aggregate_row(cost_row, y == 0, row_sums, true, false, down_paths);
+    }
+    for (int y = height - 1; y >= 0; y--) {
+        const uint16_t *cost_row = row_costs(y);
+        uint16_t *row_sums = &sums[y * row_size];
+        aggregate_row(cost_row, y == height - 1, row_sums, false, true, up_paths);
+        select_disparities(params, row_sums, disparity.ptr<short>(y));
+    }
+}
+
+// 8 paths in bands of rows: a first pass down the image keeps the state of the paths from
+// the row above at the top of each band; then, from the bottom band to the top one, these
+// paths are aggregated again through the band from its checkpoint, with the path from the
+// left, and the paths going up continue through the band, from the band below
+void SGMEngine::aggregate_bands(const SGBMParams &params, cv::Mat &disparity)
+{
+    const size_t row_size = size_t(width) * disparities;
+    const size_t checkpoint_size = 3 * (size_t(width) * (disparities + 2) + width);
+    const int bands = (height + band_rows - 1) / band_rows;
+
+    // the sums of this pass are not used
+    for (int y = 0; y < (bands - 1) * band_rows; y++) {
+        if (y % band_rows == 0 && y > 0)
+            save_paths(down_paths, &checkpoints[(y / band_rows) * checkpoint_size]);
+        aggregate_row(row_costs(y), y == 0, &sums[0], false, false, down_paths);
+    }
+    if (bands > 1)
+        save_paths(down_paths, &checkpoints[(bands - 1) * checkpoint_size]);
+
+    for (int band = bands - 1; band >= 0; band--) {
+        const int top = band * band_rows;
+        const int bottom = std::min(height, top + band_rows);
+        if (band > 0)
+            restore_paths(down_paths, &checkpoints[band * checkpoint_size]);
+
+        for (int y = top; y < bottom; y++) {
+            const uint16_t *cost_row;
+            if (keep_volume) {
+                cost_row = row_costs(y);
+            } else {
+                block_costs(y, &band_costs[(y - top) * row_size]);
+                cost_row = &band_costs[(y - top) * row_size];
+            }
+            uint16_t *row_sums = &sums[(y - top) * row_size];
+            std::fill(row_sums, row_sums + row_size, 0);
+            aggregate_row(cost_row, y == 0, row_sums, true, false, down_paths);
+        }
+        for (int y = bottom - 1; y >= top; y--) {
+            const uint16_t *cost_row = keep_volume ? row_costs(y) : &band_costs[(y - top) * row_size];
+            uint16_t *row_sums = &sums[(y - top) * row_size];
+            aggregate_row(cost_row, y == height - 1, row_sums, false, true, up_paths);
+            select_disparities(params, row_sums, disparity.ptr<short>(y));
+        }
+    }
+}
+
+// the guard elements of the paths are set once, the kernels only write the disparities
+void SGMEngine::reset_paths(VerticalPaths &paths, bool used)
+{
+    const size_t stride = disparities + 2;
+    fit(paths.costs, used ? 3 * 2 * width * stride : 0);
+    std::fill(paths.costs.begin(), paths.costs.end(), 0xffff);
+    fit(paths.minimums, used ? 3 * 2 * width : 0);
+    std::fill(paths.minimums.begin(), paths.minimums.end(), 0);
+    paths.parity = 0;
+}
+
+// the costs of the vertical paths on the previous row, and their minimums
+void SGMEngine::save_paths(const VerticalPaths &paths, uint16_t *checkpoint)
+{
+    const size_t row = size_t(width) * (disparities + 2);
+    for (int path = 0; path < 3; path++) {
+        const uint16_t *previous = &paths.costs[(path * 2 + paths.parity) * row];
+        checkpoint = std::copy(previous, previous + row, checkpoint);
+        const uint16_t *minimums = &paths.minimums[(path * 2 + paths.parity) * width];
+        checkpoint = std::copy(minimums, minimums + width, checkpoint);
+    }
+}
+
+void SGMEngine::restore_paths(VerticalPaths &paths, const uint16_t *checkpoint)
+{
+    const size_t row = size_t(width) * (disparities + 2);
+    for (int path = 0; path < 3; path++) {
+        std::copy(checkpoint, checkpoint + row, &paths.costs[(path * 2 + paths.parity) * row]);
+        checkpoint += row;
+        std::copy(checkpoint, checkpoint + width, &paths.minimums[(path * 2 + paths.parity) * width]);
+        checkpoint += width;
+    }
+}
+
+// we keep the cost volume if the estimate says so, and check whether it still holds the
+// costs of these images and parameters (the images are compared with copies of the ones
+// the volume was computed from, which costs much less than computing it)
+void SGMEngine::prepare_volume(const SGBMParams &params, const cv::Mat &left, const cv::Mat &right, bool keep)
+{
+    keep_volume = keep;
+    if (!keep_volume) {
+        std::vector<uint16_t>().swap(volume);
+        volume_left.release();
+        volume_right.release();
+        volume_rows = 0;
+        volume_reused = false;
+        return;
+    }
+
+    bool same_costs = volume_rows > 0 &&
+                      volume_params.block_size == params.block_size &&
+                      volume_params.min_disparity == params.min_disparity &&
+                      volume_params.num_disparities == params.num_disparities &&
+                      MatchingCost::same_cost(volume_params, params) &&
+                      same_image(left, volume_left) && same_image(right, volume_right);
+    if (!same_costs) {
+        // the rows are computed again as the first pass reaches them
+        volume_rows = 0;
+        fit(volume, size_t(width) * height * disparities);
+        left.copyTo(volume_left);
+        right.copyTo(volume_right);
+        volume_params = params;
+    }
+    volume_reused = volume_rows == height;
+}
+
+// the block costs of row y, from the cost volume when it holds them
+// (the first pass goes down the image, so the volume is filled in order)
+const uint16_t *SGMEngine::row_costs(int y)
+{
+    if (!keep_volume) {
+        block_costs(y, &costs[0]);
+        return &costs[0];
+    }
+
+    uint16_t *row = &volume[size_t(y) * width * disparities];
+    if (y >= volume_rows) {
+        block_costs(y, row);
+        volume_rows = y + 1;
+    }
+    return row;
+}
+
+// the costs of the pixels of row y, for all the disparities
+void SGMEngine::pixel_costs(int y, uint8_t *row)
+{
+    matching_cost->row_costs(left_image, right_image, y, min_disparity, disparities, row);
+}
+
+// the loops over the disparities of the block costs and of the selection are compiled for
+// the usual block sizes (5, 7, 9, 11) and numbers of disparities (64, 128, 256) as
+// constants, so that the compiler unrolls and vectorizes them; FIXED_D = 0 and
+// FIXED_RADIUS = -1 are the generic loops, which read them from the engine
+
+// the pixel costs of a row added to, or removed from, the sums over the rows of the block
+template <int FIXED_D, bool ADD>
+static void update_column_sums(uint16_t *__restrict column_sums, const uint8_t *__restrict row, int width,
+                               int disparities)
+{
+    const int D = FIXED_D > 0 ? FIXED_D : disparities;
+    for (int x = 0; x < width; x++, column_sums += D, row += D)
+        for (int d = 0; d < D; d++)
+            column_sums[d] = ADD ? uint16_t(column_sums[d] + row[d]) : uint16_t(column_sums[d] - row[d]);
+}
+
+// the block costs of row y, in out: we keep the sums of the pixel costs over the rows
+// of the block, updated as the block slides (in either direction), then sum them over
+// the columns of the block
+template <int FIXED_D, int FIXED_RADIUS>
+void SGMEngine::block_costs_loop(int y, uint16_t *out)
+{
+    const int D = FIXED_D > 0 ? FIXED_D : disparities;
+    const int radius = FIXED_RADIUS >= 0 ? FIXED_RADIUS : block_radius;
+    const size_t row_size = size_t(width) * D;
+    const int ring = 2 * radius + 2;
+    const int first = std::max(0, y - radius);
+    const int last = std::min(height - 1, y + radius);
+
+    // the rows leaving the block
+    while (first_summed_row <= last_summed_row && first_summed_row < first) {
+        const uint8_t *row = &pixel_cost_rows[(first_summed_row % ring) * row_size];
+        update_column_sums<FIXED_D, false>(&column_sums[0], row, width, D);
+        first_summed_row++;
+    }
+    while (first_summed_row <= last_summed_row && last_summed_row > last) {
+        const uint8_t *row = &pixel_cost_rows[(last_summed_row % ring) * row_size];
+        update_column_sums<FIXED_D, false>(&column_sums[0], row, width, D);
+        last_summed_row--;
+    }
+    if (first_summed_row > last_summed_row) {
+        first_summed_row = first;
+        last_summed_row = first - 1;
+    }
+
+    // the rows entering it
+    while (first_summed_row > first || last_summed_row < last) {
+        int added = first_summed_row > first ? --first_summed_row : ++last_summed_row;
+        uint8_t *row = &pixel_cost_rows[(added % ring) * row_size];
+        pixel_costs(added, row);
+        update_column_sums<FIXED_D, true>(&column_sums[0], row, width, D);
+    }
+
+    // the columns, with a sliding sum (on the stack for the specialized loops)
+    uint32_t fixed_sum[FIXED_D > 0 ? FIXED_D : 1];
+    uint32_t *sum = FIXED_D > 0 ? fixed_sum : &block_sum[0];
+    std::fill(sum, sum + D, 0u);
+    for (int x = 0; x <= std::min(width - 1, radius); x++)
+        for (int d = 0; d < D; d++)
+            sum[d] += column_sums[x * D + d];
+    for (int x = 0; x < width; x++) {
+        uint16_t *pixel = out + size_t(x) * D;
+        for (int d = 0; d < D; d++)
+            pixel[d] = uint16_t(sum[d] >> cost_shift);
+        if (x + radius + 1 < width) {
+            const uint16_t *entering = &column_sums[size_t(x + radius + 1) * D];
+            for (int d = 0; d < D; d++)
+                sum[d] += entering[d];
+        }
+        if (x - radius >= 0) {
+            const uint16_t *leaving = &column_sums[size_t(x - radius) * D];
+            for (int d = 0; d < D; d++)
+                sum[d] -= leaving[d];
+        }
+    }
+}
+
+// the radii 2 to 5 are the block sizes 5 to 11
+template <int FIXED_D>
+SGMEngine::BlockCostsLoop SGMEngine::block_costs_loop_for(int radius)
+{
+    switch (radius) {
+    case 2: return &SGMEngine::block_costs_loop<FIXED_D, 2>;
+    case 3: return &SGMEngine::block_costs_loop<FIXED_D, 3>;
+    case 4: return &SGMEngine::block_costs_loop<FIXED_D, 4>;
+    case 5: return &SGMEngine::block_costs_loop<FIXED_D, 5>;
+    default: return &SGMEngine::block_costs_loop<FIXED_D, -1>;
+    }
+}
+
+// the loops of the block size and the number of disparities of the current computation
+void SGMEngine::choose_loops()
+{
+    switch (disparities) {
+    case 64:
+        block_costs_kernel = block_costs_loop_for<64>(block_radius);
+        select_kernel = &SGMEngine::select_loop<64>;
+        break;
+    case 128:
+        block_costs_kernel = block_costs_loop_for<128>(block_radius);
+        select_kernel = &SGMEngine::select_loop<128>;
+        break;
+    case 256:
+        block_costs_kernel = block_costs_loop_for<256>(block_radius);
+        select_kernel = &SGMEngine::select_loop<256>;
+        break;
+    default:
+        block_costs_kernel = &SGMEngine::block_costs_loop<0, -1>;
+        select_kernel = &SGMEngine::select_loop<0>;
+        break;
+    }
+}
+
+// we add the paths ending on the current row to row_sums: the horizontal ones asked for, and
+// the three coming from the previous row (the row above when going down, below when going up)
+void SGMEngine::aggregate_row(const uint16_t *cost_row, bool first_row, uint16_t *row_sums,
+                              bool left_to_right, bool right_to_left, VerticalPaths &vertical)
+{
+    const int D = disparities;
+    const int stride = D + 2;
+    const uint16_t *start = &start_path[1];
+
+    for (int direction = 0; direction < 2; direction++) {
+        if ((direction == 0 && !left_to_right) || (direction == 1 && !right_to_left))
+            continue;
+        int x = direction == 0 ? 0 : width - 1;
+        int step = direction == 0 ? 1 : -1;
+        const uint16_t *previous = start;
+        uint16_t previous_min = 0;
+        for (int i = 0; i < width; i++, x += step) {
+            uint16_t *current = &horizontal_paths[(i & 1) * stride + 1];
+            previous_min = aggregate(cost_row + size_t(x) * D, previous, previous_min,
+                                     current, row_sums + size_t(x) * D, D, P1, P2);
+            previous = current;
+        }
+    }
+
+    // the previous pixel of the path is at column x + offset of the previous row
+    const int parity = vertical.parity;
+    for (int offset = -1; offset <= 1; offset++) {
+        int path = offset + 1;
+        const uint16_t *previous_row = &vertical.costs[(path * 2 + parity) * size_t(width) * stride];
+        uint16_t *current_row = &vertical.costs[(path * 2 + 1 - parity) * size_t(width) * stride];
+        const uint16_t *previous_minimums = &vertical.minimums[(path * 2 + parity) * width];
+        uint16_t *current_minimums = &vertical.minimums[(path * 2 + 1 - parity) * width];
+        for (int x = 0; x < width; x++) {
+            int previous_x = x + offset;
+            bool path_start = first_row || previous_x < 0 || previous_x >= width;
+            current_minimums[x] = aggregate(cost_row + size_t(x) * D,
+                                            path_start ? start : previous_row + size_t(previous_x) * stride + 1,
+                                            path_start ? 0 : previous_minimums[previous_x],
+                                            current_row + size_t(x) * stride + 1,
+                                            row_sums + size_t(x) * D, D, P1, P2);
+        }
+    }
+    vertical.parity = 1 - parity;
+}
+
+// the loops of the selection of a pixel, with no early exit nor branch so that they are
+// vectorized
+
+template <int FIXED_D>
+static uint16_t least_cost(const uint16_t *costs, int disparities)
+{
+    const int D = FIXED_D > 0 ? FIXED_D : disparities;
+    uint16_t least = costs[0];
+    for (int d = 1; d < D; d++)
+        least = std::min(least, costs[d]);
+    return least;
+}
+
+// the least cost of the pixels of the right image along the diagonal of the sums: costs[d]
+// is the one of the pixel right_costs[D - 1 - d] of a pixel at disparity d
+template <int FIXED_D>
+static void match_right(const uint16_t *__restrict costs, int disparities, int min_disparity,
+                        uint16_t *__restrict right_costs, int *__restrict right_disparities)
+{
+    const int D = FIXED_D > 0 ? FIXED_D : disparities;
+    for (int d = 0; d < D; d++) {
+        const int r = D - 1 - d;
+        const bool better = costs[d] < right_costs[r];
+        right_disparities[r] = better ? min_disparity + d : right_disparities[r];
+        right_costs[r] = better ? costs[d] : right_costs[r];
+    }
+}
+
+// true if another disparity, not next to the best one, is almost as good
+template <int FIXED_D>
+static bool ambiguous(const uint16_t *costs, int disparities, int best, int best_cost, int uniqueness_ratio)
+{
+    const int D = FIXED_D > 0 ? FIXED_D : disparities;
+    const int ratio = 100 - uniqueness_ratio;
+    int found = 0;
+    for (int d = 0; d < D; d++)
+        found |= (costs[d] * ratio < best_cost * 100) & (std::abs(best - d) > 1);
+    return found != 0;
+}
+
+// the winner-takes-all of cv::StereoSGBM on one row: the disparity of least cost, if it is
+// unique enough, refined by fitting a parabola, then checked against the disparities of
+// the right image (the least cost along the diagonals of the sums)
+template <int FIXED_D>
+void SGMEngine::select_loop(const SGBMParams &params, const uint16_t *row_sums, short *disparity)
+{
+    const int D = FIXED_D > 0 ? FIXED_D : disparities;
+    const int scale = cv::StereoMatcher::DISP_SCALE;
+    const short invalid = short((min_disparity - 1) * scale);
+    const int first_x = std::max(min_disparity + D, 0);
+    const int end_x = width + std::min(min_disparity, 0);
+    const bool check = params.disp12_max_diff >= 0;
+
+    if (check) {
+        std::fill(right_costs.begin(), right_costs.end(), 0xffff);
+        std::fill(right_disparities.begin(), right_disparities.end(), -1);
+    }
+
+    for (int x = 0; x < width; x++) {
+        if (x < first_x || x >= end_x) {
+            disparity[x] = invalid;
+            continue;
+        }
+
+        const uint16_t *s = row_sums + size_t(x) * D;
+        uint16_t best_cost = least_cost<FIXED_D>(s, D);
+        int best = 0;
+        while (s[best] != best_cost)
+            best++;
+
+        // the pixels between first_x and end_x only match pixels inside the right image
+        if (check)
+            match_right<FIXED_D>(s, D, min_disparity, &right_costs[x - min_disparity - D + 1],
+                                 &right_disparities[x - min_disparity - D + 1]);
+
+        if (ambiguous<FIXED_D>(s, D, best, best_cost, params.uniqueness_ratio)) {
+            disparity[x] = invalid;
+            continue;
+        }
+
+        int value = best * scale;
+        if (best > 0 && best < D - 1) {
+            int denominator = std::max(s[best - 1] + s[best + 1] - 2 * s[best], 1);
+            value += ((s[best - 1] - s[best + 1]) * scale + denominator) / (denominator * 2);
+        }
+        disparity[x] = short(value + min_disparity * scale);
+    }
+
+    // the pixel of the right image matched by each pixel should match it back
+    if (check) {
+        for (int x = first_x; x < end_x; x++) {
+            int value = disparity[x];
+            if (value == invalid)
+                continue;
+            int low = value >> cv::StereoMatcher::DISP_SHIFT;
+            int high = (value + scale - 1) >> cv::StereoMatcher::DISP_SHIFT;
+            int low_x = x - low, high_x = x - high;
+            if (low_x >= 0 && low_x < width && right_disparities[low_x] >= min_disparity &&
+                    std::abs(right_disparities[low_x] - low) > params.disp12_max_diff &&
+                    high_x >= 0 && high_x < width && right_disparities[high_x] >= min_disparity &&
+                    std::abs(right_disparities[high_x] - high) > params.disp12_max_diff)
+                disparity[x] = invalid;
+        }
+    }
+}
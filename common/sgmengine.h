@@ -0,0 +1,191 @@
+#ifndef SGMENGINE_H
+#define SGMENGINE_H
+
+#include "opencv2/core/core.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+#include "sgbmparams.h"
+#include "sgmcosts.h"
+#include "sgmkernels.h"
+
+// semi-global matching implemented in the tuner, an alternative to cv::StereoSGBM
+//
+// the cost of matching two pixels is one of the costs of sgmcosts.h (by default, the
+// Hamming distance between their 5x5 census transforms), summed over the block; the costs
+// are aggregated along 5 paths
+// (left, right, and the three paths coming from the row above), or 8 paths in the
+// MODE_HH mode of cv::StereoSGBM (the three paths of the row below as well), then each
+// pixel takes the disparity of least aggregated cost
+// the selection is the one of cv::StereoSGBM (uniqueness ratio, subpixel interpolation,
+// left-right check, speckle filter, invalid columns on the left), and so is the output
+// (CV_16SC1, in 1/16 of pixel, (min_disparity - 1) * 16 where invalid): the maps can be
+// displayed, cached and filtered like the ones of OpenCV
+// P1 and P2 keep their meaning: penalties in the units of the block cost, which grows with
+// the area of the block like the one of cv::StereoSGBM (the range of a pixel cost depends on
+// the cost, so the penalties are tuned for each one); the pre-filter cap only truncates the
+// intensities of the zero-mean SAD cost
+//
+// the aggregation runs on the SIMD kernels of the fastest instruction set of the processor
+// (see sgmkernels.h); the block costs and the selection are compiled for the usual block
+// sizes (5, 7, 9, 11) and numbers of disparities (64, 128, 256), the values of the sliders
+// of the tuner, and left to the compiler to vectorize, with a generic version for the others
+// the block costs of the whole image (the cost volume) are kept between two calls when they
+// fit in the budget: while the images, the block size and the disparity range do not change,
+// tuning P1, P2, the uniqueness ratio or the post-processing only aggregates them again
+// with 8 paths, the costs aggregated down the image are needed by the paths going up: under
+// a memory limit, they are kept for a band of rows at a time (see set_memory_limit())
+// the buffers are kept between two calls; an engine must only be used by one thread at a time
+class SGMEngine
+{
+public:
+    SGMEngine();
+
+    // the instruction set of the kernels (the fastest one by default)
+    void set_isa(SimdIsa isa);
+    SimdIsa isa() const { return simd_isa; }
+
+    // the memory the cost volume may use, in bytes (0 to never keep it); above it, the block
+    // costs are computed row by row, and computed again by the next call
+    enum { DEFAULT_COST_VOLUME_BUDGET_MB = 512 };
+    void set_cost_volume_budget(size_t bytes);
+    size_t cost_volume_budget() const { return volume_budget; }
+
+    // the size of the cost volume for images of this size matched with these parameters
+    static size_t cost_volume_size(const cv::Size &size, const SGBMParams &params);
+
+    // true if the last computation found the cost volume of the previous one, and only
+    // aggregated it
+    bool reused_cost_volume() const { return volume_reused; }
+
+    // the memory the engine may use, in bytes (0 for no limit, the default)
+    // with 8 paths, the image is then processed in bands of rows, from the bottom one to
+    // the top one: a first pass down the image only keeps the state of the paths going
+    // down at the top of each band, from which they are aggregated again through the
+    // band; the result is the same, for about a third more aggregation
+    // the cost volume is only kept if it fits under the limit as well
+    // the bands need a checkpoint each, so the memory can not go below a floor: under a
+    // lower limit, the engine uses the bands of least memory (see estimate_memory())
+    void set_memory_limit(size_t bytes);
+    size_t memory_limit() const { return limit; }
+
+    // the memory used by the engine for images of this size (its own buffers, plus the one
+    // of the speckle filter; not the images nor the disparity map)
+    // when the engine can not stay under the memory limit, the estimate is the one of the
+    // least memory it can use, which it then uses
+    struct MemoryEstimate {
+        size_t peak_bytes;
+        bool keeps_cost_volume;
+        int band_rows;   // with 8 paths, the rows aggregated at once (the height: in one piece)
+        bool fits;       // false if the engine can not stay under the memory limit
+    };
+    static MemoryEstimate estimate_memory(const cv::Size &size, const SGBMParams &params,
+                                          size_t memory_limit, size_t cost_volume_budget);
+
+    // we compute the disparity of left with respect to right (CV_8UC1 images of the same
+    // size), like cv::StereoSGBM::compute()
+    // a cv::Exception is thrown for parameters the engine can not use
+    void compute(const SGBMParams &params, const cv::Mat &left, const cv::Mat &right, cv::Mat &disparity);
+
+    // the number of aggregation paths for a mode of cv::StereoSGBM
+    static int path_count(int mode);
+
+private:
+    SimdIsa simd_isa;
+    AggregateKernel aggregate;
+    size_t limit;
+
+    // the geometry of the current computation
+    int width;
+    int height;
+    int disparities;
+    int min_disparity;
+    int block_radius;
+    int cost_shift;   // the block costs are divided by 2^cost_shift to fit in 16 bits
+    uint16_t P1;
+    uint16_t P2;
+    int band_rows;
+
+    // the images of the current computation, and the cost comparing their pixels (created
+    // again when the cost or the parameters it reads change)
+    cv::Mat left_image;
+    cv::Mat right_image;
+    cv::Ptr<MatchingCost> matching_cost;
+    SGBMParams cost_params;
+
+    // the block costs: the pixel costs of the rows of the block (a ring of rows), their
+    // sums over these rows, and the block costs of the current row (without cost volume)
+    std::vector<uint8_t> pixel_cost_rows;
+    std::vector<uint16_t> column_sums;
+    std::vector<uint32_t> block_sum;
+    int first_summed_row;
+    int last_summed_row;
+    std::vector<uint16_t> costs;
+    std::vector<uint16_t> band_costs;   // the block costs of a band (without cost volume)
+
+    // the cost volume, its first volume_rows rows computed, for these images and parameters
+    size_t volume_budget;
+    bool keep_volume;
+    bool volume_reused;
+    std::vector<uint16_t> volume;
+    int volume_rows;
+    cv::Mat volume_left;
+    cv::Mat volume_right;
+    SGBMParams volume_params;
+
+    // the aggregated costs: one row, or the rows of a band when the paths go both down and up
+    std::vector<uint16_t> sums;
+
+    // the costs of the previous pixel of each path, with a guard element around the
+    // disparities of each pixel (see AggregateKernel)
+    std::vector<uint16_t> start_path;   // before the first pixel of a path
+    std::vector<uint16_t> horizontal_paths;
+
+    // the three paths coming from the previous row: their costs and minimums on two rows,
+    // the previous one and the current one, which swap at each row
+    struct VerticalPaths {
+        VerticalPaths() : parity(0) {}
+        std::vector<uint16_t> costs;
+        std::vector<uint16_t> minimums;
+        int parity;
+    };
+    VerticalPaths down_paths;
+    VerticalPaths up_paths;
+    std::vector<uint16_t> checkpoints;   // the state of down_paths at the top of each band
+
+    // the disparity selection
+    std::vector<uint16_t> right_costs;
+    std::vector<int> right_disparities;
+    cv::Mat speckle_buffer;
+
+    // the block costs and the disparity selection of a row, compiled for the usual block sizes
+    // and numbers of disparities (see choose_loops()), or generic
+    typedef void (SGMEngine::*BlockCostsLoop)(int y, uint16_t *out);
+    typedef void (SGMEngine::*SelectLoop)(const SGBMParams &params, const uint16_t *row_sums, short *disparity);
+    BlockCostsLoop block_costs_kernel;
+    SelectLoop select_kernel;
+    void choose_loops();
+    template <int FIXED_D> static BlockCostsLoop block_costs_loop_for(int radius);
+    template <int FIXED_D, int FIXED_RADIUS> void block_costs_loop(int y, uint16_t *out);
+    template <int FIXED_D> void select_loop(const SGBMParams &params, const uint16_t *row_sums, short *disparity);
+
+    void pixel_costs(int y, uint8_t *row);
+    void block_costs(int y, uint16_t *out) { (this->*block_costs_kernel)(y, out); }
+    const uint16_t *row_costs(int y);
+    void prepare_volume(const SGBMParams &params, const cv::Mat &left, const cv::Mat &right, bool keep);
+    void reset_paths(VerticalPaths &paths, bool used);
+    void save_paths(const VerticalPaths &paths, uint16_t *checkpoint);
+    void restore_paths(VerticalPaths &paths, const uint16_t *checkpoint);
+    void aggregate_row(const uint16_t *cost_row, bool first_row, uint16_t *row_sums,
+                       bool left_to_right, bool right_to_left, VerticalPaths &vertical);
+    void aggregate_single_pass(const SGBMParams &params, cv::Mat &disparity);
+    void aggregate_whole(const SGBMParams &params, cv::Mat &disparity);
+    void aggregate_bands(const SGBMParams &params, cv::Mat &disparity);
+    void select_disparities(const SGBMParams &params, const uint16_t *row_sums, short *disparity)
+    {
+        (this->*select_kernel)(params, row_sums, disparity);
+    }
+};
+
+#endif // SGMENGINE_H
@@ -0,0 +1,432 @@
+#include "sgmkernels.h"
+
+#include <algorithm>
+
+// the x86 kernels are compiled for their instruction set with target attributes, so the
+// rest of the program does not depend on it, and the processor is checked at runtime
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SGM_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define SGM_NEON_KERNELS
+#include <arm_neon.h>
+#endif
+
+static uint16_t aggregate_scalar(const uint16_t *cost, const uint16_t *previous, uint16_t previous_min,
+                                 uint16_t *current, uint16_t *sum, int count, uint16_t P1, uint16_t P2)
+{
+    const unsigned jump = std::min(0xffffu, unsigned(previous_min) + P2);
+    unsigned current_min = 0xffff;
+    for (int d = 0; d < count; d++) {
+        unsigned best = std::min(unsigned(previous[d]), jump);
+        best = std::min(best, std::min(0xffffu, unsigned(std::min(previous[d - 1], previous[d + 1])) + P1));
+        unsigned value = std::min(0xffffu, cost[d] + best - previous_min);
+        current[d] = uint16_t(value);
+        sum[d] = uint16_t(std::min(0xffffu, sum[d] + value));
+        current_min = std::min(current_min, value);
+    }
+    return uint16_t(current_min);
+}
+
+static inline int popcount(uint32_t value)
+{
+#ifdef __GNUC__
+    return __builtin_popcount(value);
+#else
+    int count = 0;
+    for (; value; value &= value - 1)
+        count++;
+    return count;
+#endif
+}
+
+static void hamming_scalar(uint32_t value, const uint32_t *candidates, uint8_t *costs, int count, bool accumulate)
+{
+    for (int d = 0; d < count; d++) {
+        int distance = popcount(value ^ candidates[d]);
+        costs[d] = uint8_t(accumulate ? std::min(255, costs[d] + distance) : distance);
+    }
+}
+
+static void interval_scalar(uint8_t value, uint8_t minimum, uint8_t maximum,
+                            const uint8_t *values, const uint8_t *minimums, const uint8_t *maximums,
+                            uint8_t *costs, int count)
+{
+    for (int d = 0; d < count; d++) {
+        int left = std::max(0, std::max(value - maximums[d], minimums[d] - value));
+        int right = std::max(0, std::max(values[d] - maximum, minimum - values[d]));
+        costs[d] = uint8_t(std::min(left, right));
+    }
+}
+
+#ifdef SGM_X86_KERNELS
+
+__attribute__((target("sse4.1")))
+static uint16_t aggregate_sse41(const uint16_t *cost, const uint16_t *previous, uint16_t previous_min,
+                                uint16_t *current, uint16_t *sum, int count, uint16_t P1, uint16_t P2)
+{
+    const __m128i p1 = _mm_set1_epi16(short(P1));
+    const __m128i minimum = _mm_set1_epi16(short(previous_min));
+    const __m128i jump = _mm_adds_epu16(minimum, _mm_set1_epi16(short(P2)));
+    __m128i current_min = _mm_set1_epi16(-1);
+    for (int d = 0; d < count; d += 8) {
+        __m128i best = _mm_min_epu16(_mm_adds_epu16(_mm_loadu_si128((const __m128i *)(previous + d - 1)), p1),
+                                     _mm_adds_epu16(_mm_loadu_si128((const __m128i *)(previous + d + 1)), p1));
+        best = _mm_min_epu16(best, _mm_min_epu16(_mm_loadu_si128((const __m128i *)(previous + d)), jump));
+        __m128i value = _mm_adds_epu16(_mm_loadu_si128((const __m128i *)(cost + d)), _mm_subs_epu16(best, minimum));
+        _mm_storeu_si128((__m128i *)(current + d), value);
+        _mm_storeu_si128((__m128i *)(sum + d), _mm_adds_epu16(_mm_loadu_si128((const __m128i *)(sum + d)), value));
+        current_min = _mm_min_epu16(current_min, value);
+    }
+    return uint16_t(_mm_extract_epi16(_mm_minpos_epu16(current_min), 0));
+}
+
+__attribute__((target("avx2")))
+static uint16_t aggregate_avx2(const uint16_t *cost, const uint16_t *previous, uint16_t previous_min,
+                               uint16_t *current, uint16_t *sum, int count, uint16_t P1, uint16_t P2)
+{
+    const __m256i p1 = _mm256_set1_epi16(short(P1));
+    const __m256i minimum = _mm256_set1_epi16(short(previous_min));
+    const __m256i jump = _mm256_adds_epu16(minimum, _mm256_set1_epi16(short(P2)));
+    __m256i current_min = _mm256_set1_epi16(-1);
+    for (int d = 0; d < count; d += 16) {
+        __m256i best = _mm256_min_epu16(_mm256_adds_epu16(_mm256_loadu_si256((const __m256i *)(previous + d - 1)), p1),
+                                        _mm256_adds_epu16(_mm256_loadu_si256((const __m256i *)(previous + d + 1)), p1));
+        best = _mm256_min_epu16(best, _mm256_min_epu16(_mm256_loadu_si256((const __m256i *)(previous + d)), jump));
+        __m256i value = _mm256_adds_epu16(_mm256_loadu_si256((const __m256i *)(cost + d)), _mm256_subs_epu16(best, minimum));
+        _mm256_storeu_si256((__m256i *)(current + d), value);
+        _mm256_storeu_si256((__m256i *)(sum + d), _mm256_adds_epu16(_mm256_loadu_si256((const __m256i *)(sum + d)), value));
+        current_min = _mm256_min_epu16(current_min, value);
+    }
+    __m128i half_min = _mm_min_epu16(_mm256_castsi256_si128(current_min), _mm256_extracti128_si256(current_min, 1));
+    return uint16_t(_mm_extract_epi16(_mm_minpos_epu16(half_min), 0));
+}
+
+// 32 disparities at a time, and the last 16 with AVX2 when count is not a multiple of 32
+__attribute__((target("avx512bw")))
+static uint16_t aggregate_avx512(const uint16_t *cost, const uint16_t *previous, uint16_t previous_min,
+                                 uint16_t *current, uint16_t *sum, int count, uint16_t P1, uint16_t P2)
+{
+    const __m512i p1 = _mm512_set1_epi16(short(P1));
+    const __m512i minimum = _mm512_set1_epi16(short(previous_min));
+    const __m512i jump = _mm512_adds_epu16(minimum, _mm512_set1_epi16(short(P2)));
+    __m512i current_min = _mm512_set1_epi16(-1);
+    int d = 0;
+    for (; d + 32 <= count; d += 32) {
+        __m512i best = _mm512_min_epu16(_mm512_adds_epu16(_mm512_loadu_si512(previous + d - 1), p1),
+                                        _mm512_adds_epu16(_mm512_loadu_si512(previous + d + 1), p1));
+        best = _mm512_min_epu16(best, _mm512_min_epu16(_mm512_loadu_si512(previous + d), jump));
+        __m512i value = _mm512_adds_epu16(_mm512_loadu_si512(cost + d), _mm512_subs_epu16(best, minimum));
+        _mm512_storeu_si512(current + d, value);
+        _mm512_storeu_si512(sum + d, _mm512_adds_epu16(_mm512_loadu_si512(sum + d), value));
+        current_min = _mm512_min_epu16(current_min, value);
+    }
+
+    // the halves of the minimum go through memory (the 512 bits extractions make GCC warn)
+    uint16_t lanes[32];
+    _mm512_storeu_si512(lanes, current_min);
+    __m256i quarter_min = _mm256_min_epu16(_mm256_loadu_si256((const __m256i *)lanes),
+                                           _mm256_loadu_si256((const __m256i *)(lanes + 16)));
+    if (d < count) {
+        const __m256i p1_256 = _mm256_set1_epi16(short(P1));
+        const __m256i minimum_256 = _mm256_set1_epi16(short(previous_min));
+        const __m256i jump_256 = _mm256_adds_epu16(minimum_256, _mm256_set1_epi16(short(P2)));
+        __m256i best = _mm256_min_epu16(_mm256_adds_epu16(_mm256_loadu_si256((const __m256i *)(previous + d - 1)), p1_256),
+                                        _mm256_adds_epu16(_mm256_loadu_si256((const __m256i *)(previous + d + 1)), p1_256));
+        best = _mm256_min_epu16(best, _mm256_min_epu16(_mm256_loadu_si256((const __m256i *)(previous + d)), jump_256));
+        __m256i value = _mm256_adds_epu16(_mm256_loadu_si256((const __m256i *)(cost + d)), _mm256_subs_epu16(best, minimum_256));
+        _mm256_storeu_si256((__m256i *)(current + d), value);
+        _mm256_storeu_si256((__m256i *)(sum + d), _mm256_adds_epu16(_mm256_loadu_si256((const __m256i *)(sum + d)), value));
+        quarter_min = _mm256_min_epu16(quarter_min, value);
+    }
+    __m128i half_min = _mm_min_epu16(_mm256_castsi256_si128(quarter_min), _mm256_extracti128_si256(quarter_min, 1));
+    return uint16_t(_mm_extract_epi16(_mm_minpos_epu16(half_min), 0));
+}
+
+// the bits set in each 32 bits word: a table of the counts of the 16 nibbles, looked up with
+// a byte shuffle, then the counts of the 4 bytes are added
+__attribute__((target("sse4.1")))
+static inline __m128i popcount_epi32_sse41(__m128i words)
+{
+    const __m128i nibble_counts = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i low_nibbles = _mm_set1_epi8(0x0f);
+    __m128i bytes = _mm_add_epi8(_mm_shuffle_epi8(nibble_counts, _mm_and_si128(words, low_nibbles)),
+                                 _mm_shuffle_epi8(nibble_counts, _mm_and_si128(_mm_srli_epi16(words, 4), low_nibbles)));
+    return _mm_madd_epi16(_mm_maddubs_epi16(bytes, _mm_set1_epi8(1)), _mm_set1_epi16(1));
+}
+
+__attribute__((target("sse4.1")))
+static void hamming_sse41(uint32_t value, const uint32_t *candidates, uint8_t *costs, int count, bool accumulate)
+{
+    const __m128i bits = _mm_set1_epi32(int(value));
+    for (int d = 0; d < count; d += 16) {
+        __m128i distances[4];
+        for (int i = 0; i < 4; i++)
+            distances[i] = popcount_epi32_sse41(_mm_xor_si128(bits, _mm_loadu_si128((const __m128i *)(candidates + d + 4 * i))));
+        __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(distances[0], distances[1]),
+                                         _mm_packus_epi32(distances[2], distances[3]));
+        if (accumulate)
+            bytes = _mm_adds_epu8(bytes, _mm_loadu_si128((const __m128i *)(costs + d)));
+        _mm_storeu_si128((__m128i *)(costs + d), bytes);
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void interval_sse41(uint8_t value, uint8_t minimum, uint8_t maximum,
+                           const uint8_t *values, const uint8_t *minimums, const uint8_t *maximums,
+                           uint8_t *costs, int count)
+{
+    const __m128i pixel = _mm_set1_epi8(char(value));
+    const __m128i low = _mm_set1_epi8(char(minimum));
+    const __m128i high = _mm_set1_epi8(char(maximum));
+    for (int d = 0; d < count; d += 16) {
+        __m128i candidate = _mm_loadu_si128((const __m128i *)(values + d));
+        __m128i left = _mm_max_epu8(_mm_subs_epu8(pixel, _mm_loadu_si128((const __m128i *)(maximums + d))),
+                                    _mm_subs_epu8(_mm_loadu_si128((const __m128i *)(minimums + d)), pixel));
+        __m128i right = _mm_max_epu8(_mm_subs_epu8(candidate, high), _mm_subs_epu8(low, candidate));
+        _mm_storeu_si128((__m128i *)(costs + d), _mm_min_epu8(left, right));
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i popcount_epi32_avx2(__m256i words)
+{
+    const __m256i nibble_counts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                   0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(nibble_counts, _mm256_and_si256(words, low_nibbles)),
+                                    _mm256_shuffle_epi8(nibble_counts, _mm256_and_si256(_mm256_srli_epi16(words, 4), low_nibbles)));
+    return _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, _mm256_set1_epi8(1)), _mm256_set1_epi16(1));
+}
+
+__attribute__((target("avx2")))
+static void hamming_avx2(uint32_t value, const uint32_t *candidates, uint8_t *costs, int count, bool accumulate)
+{
+    const __m256i bits = _mm256_set1_epi32(int(value));
+    for (int d = 0; d < count; d += 16) {
+        __m256i first = popcount_epi32_avx2(_mm256_xor_si256(bits, _mm256_loadu_si256((const __m256i *)(candidates + d))));
+        __m256i second = popcount_epi32_avx2(_mm256_xor_si256(bits, _mm256_loadu_si256((const __m256i *)(candidates + d + 8))));
+
+        // the packing works within each half of the registers, the permutation restores the order
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(first, second), _MM_SHUFFLE(3, 1, 2, 0));
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        if (accumulate)
+            bytes = _mm_adds_epu8(bytes, _mm_loadu_si128((const __m128i *)(costs + d)));
+        _mm_storeu_si128((__m128i *)(costs + d), bytes);
+    }
+}
+
+// 32 disparities at a time, and the last 16 with SSE when count is not a multiple of 32
+__attribute__((target("avx2")))
+static void interval_avx2(uint8_t value, uint8_t minimum, uint8_t maximum,
+                          const uint8_t *values, const uint8_t *minimums, const uint8_t *maximums,
+                          uint8_t *costs, int count)
+{
+    const __m256i pixel = _mm256_set1_epi8(char(value));
+    const __m256i low = _mm256_set1_epi8(char(minimum));
+    const __m256i high = _mm256_set1_epi8(char(maximum));
+    int d = 0;
+    for (; d + 32 <= count; d += 32) {
+        __m256i candidate = _mm256_loadu_si256((const __m256i *)(values + d));
+        __m256i left = _mm256_max_epu8(_mm256_subs_epu8(pixel, _mm256_loadu_si256((const __m256i *)(maximums + d))),
+                                       _mm256_subs_epu8(_mm256_loadu_si256((const __m256i *)(minimums + d)), pixel));
+        __m256i right = _mm256_max_epu8(_mm256_subs_epu8(candidate, high), _mm256_subs_epu8(low, candidate));
+        _mm256_storeu_si256((__m256i *)(costs + d), _mm256_min_epu8(left, right));
+    }
+    if (d < count)
+        interval_sse41(value, minimum, maximum, values + d, minimums + d, maximums + d, costs + d, count - d);
+}
+
+// the table and the conversion avoid the intrinsics starting from undefined registers, which
+// make GCC warn
+__attribute__((target("avx512bw")))
+static void hamming_avx512(uint32_t value, const uint32_t *candidates, uint8_t *costs, int count, bool accumulate)
+{
+    const __m512i nibble_counts = _mm512_set4_epi32(0x04030302, 0x03020201, 0x03020201, 0x02010100);
+    const __m512i low_nibbles = _mm512_set1_epi8(0x0f);
+    const __m512i bits = _mm512_set1_epi32(int(value));
+    for (int d = 0; d < count; d += 16) {
+        __m512i words = _mm512_xor_si512(bits, _mm512_loadu_si512(candidates + d));
+        __m512i bytes = _mm512_add_epi8(_mm512_shuffle_epi8(nibble_counts, _mm512_and_si512(words, low_nibbles)),
+                                        _mm512_shuffle_epi8(nibble_counts, _mm512_and_si512(_mm512_srli_epi16(words, 4), low_nibbles)));
+        __m512i distances = _mm512_madd_epi16(_mm512_maddubs_epi16(bytes, _mm512_set1_epi8(1)), _mm512_set1_epi16(1));
+        __m128i result = _mm512_maskz_cvtepi32_epi8(0xffff, distances);
+        if (accumulate)
+            result = _mm_adds_epu8(result, _mm_loadu_si128((const __m128i *)(costs + d)));
+        _mm_storeu_si128((__m128i *)(costs + d), result);
+    }
+}
+
+// 64 disparities at a time, the last ones with masked loads and stores
+__attribute__((target("avx512bw")))
+static void interval_avx512(uint8_t value, uint8_t minimum, uint8_t maximum,
+                            const uint8_t *values, const uint8_t *minimums, const uint8_t *maximums,
+                            uint8_t *costs, int count)
+{
+    const __m512i pixel = _mm512_set1_epi8(char(value));
+    const __m512i low = _mm512_set1_epi8(char(minimum));
+    const __m512i high = _mm512_set1_epi8(char(maximum));
+    for (int d = 0; d < count; d += 64) {
+        __mmask64 mask = count - d >= 64 ? ~__mmask64(0) : (__mmask64(1) << (count - d)) - 1;
+        __m512i candidate = _mm512_maskz_loadu_epi8(mask, values + d);
+        __m512i left = _mm512_max_epu8(_mm512_subs_epu8(pixel, _mm512_maskz_loadu_epi8(mask, maximums + d)),
+                                       _mm512_subs_epu8(_mm512_maskz_loadu_epi8(mask, minimums + d), pixel));
+        __m512i right = _mm512_max_epu8(_mm512_subs_epu8(candidate, high), _mm512_subs_epu8(low, candidate));
+        _mm512_mask_storeu_epi8(costs + d, mask, _mm512_min_epu8(left, right));
+    }
+}
+
+#endif // SGM_X86_KERNELS
+
+#ifdef SGM_NEON_KERNELS
+
+static uint16_t aggregate_neon(const uint16_t *cost, const uint16_t *previous, uint16_t previous_min,
+                               uint16_t *current, uint16_t *sum, int count, uint16_t P1, uint16_t P2)
+{
+    const uint16x8_t p1 = vdupq_n_u16(P1);
+    const uint16x8_t minimum = vdupq_n_u16(previous_min);
+    const uint16x8_t jump = vqaddq_u16(minimum, vdupq_n_u16(P2));
+    uint16x8_t current_min = vdupq_n_u16(0xffff);
+    for (int d = 0; d < count; d += 8) {
+        uint16x8_t best = vminq_u16(vqaddq_u16(vld1q_u16(previous + d - 1), p1),
+                                    vqaddq_u16(vld1q_u16(previous + d + 1), p1));
+        best = vminq_u16(best, vminq_u16(vld1q_u16(previous + d), jump));
+        uint16x8_t value = vqaddq_u16(vld1q_u16(cost + d), vqsubq_u16(best, minimum));
+        vst1q_u16(current + d, value);
+        vst1q_u16(sum + d, vqaddq_u16(vld1q_u16(sum + d), value));
+        current_min = vminq_u16(current_min, value);
+    }
+    return vminvq_u16(current_min);
+}
+
+static void hamming_neon(uint32_t value, const uint32_t *candidates, uint8_t *costs, int count, bool accumulate)
+{
+    const uint32x4_t bits = vdupq_n_u32(value);
+    for (int d = 0; d < count; d += 16) {
+        uint16x4_t distances[4];
+        for (int i = 0; i < 4; i++) {
+            uint8x16_t bytes = vcntq_u8(vreinterpretq_u8_u32(veorq_u32(bits, vld1q_u32(candidates + d + 4 * i))));
+            distances[i] = vmovn_u32(vpaddlq_u16(vpaddlq_u8(bytes)));
+        }
+        uint8x16_t result = vcombine_u8(vmovn_u16(vcombine_u16(distances[0], distances[1])),
+                                        vmovn_u16(vcombine_u16(distances[2], distances[3])));
+        if (accumulate)
+            result = vqaddq_u8(result, vld1q_u8(costs + d));
+        vst1q_u8(costs + d, result);
+    }
+}
+
+static void interval_neon(uint8_t value, uint8_t minimum, uint8_t maximum,
+                          const uint8_t *values, const uint8_t *minimums, const uint8_t *maximums,
+                          uint8_t *costs, int count)
+{
+    const uint8x16_t pixel = vdupq_n_u8(value);
+    const uint8x16_t low = vdupq_n_u8(minimum);
+    const uint8x16_t high = vdupq_n_u8(maximum);
+    for (int d = 0; d < count; d += 16) {
+        uint8x16_t candidate = vld1q_u8(values + d);
+        uint8x16_t left = vmaxq_u8(vqsubq_u8(pixel, vld1q_u8(maximums + d)), vqsubq_u8(vld1q_u8(minimums + d), pixel));
+        uint8x16_t right = vmaxq_u8(vqsubq_u8(candidate, high), vqsubq_u8(low, candidate));
+        vst1q_u8(costs + d, vminq_u8(left, right));
+    }
+}
+
+#endif // SGM_NEON_KERNELS
+
+bool simd_isa_supported(SimdIsa isa)
+{
+    switch (isa) {
+    case SIMD_SCALAR:
+        return true;
+#ifdef SGM_X86_KERNELS
+    case SIMD_SSE41:
+        return __builtin_cpu_supports("sse4.1");
+    case SIMD_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case SIMD_AVX512:
+        return __builtin_cpu_supports("avx512bw");
+#endif
+#ifdef SGM_NEON_KERNELS
+    case SIMD_NEON:
+        return true;  // part of the base instruction set of 64 bits ARM
+#endif
+    default:
+        return false;
+    }
+}
+
+SimdIsa best_simd_isa()
+{
+    const SimdIsa fastest_first[] = { SIMD_AVX512, SIMD_AVX2, SIMD_NEON, SIMD_SSE41 };
+    for (size_t i = 0; i < sizeof(fastest_first) / sizeof(fastest_first[0]); i++)
+        if (simd_isa_supported(fastest_first[i]))
+            return fastest_first[i];
+    return SIMD_SCALAR;
+}
+
+const char *simd_isa_name(SimdIsa isa)
+{
+    switch (isa) {
+    case SIMD_SSE41: return "sse4.1";
+    case SIMD_AVX2: return "avx2";
+    case SIMD_AVX512: return "avx512";
+    case SIMD_NEON: return "neon";
+    default: return "scalar";
+    }
+}
+
+AggregateKernel aggregate_kernel(SimdIsa isa)
+{
+    if (!simd_isa_supported(isa))
+        return aggregate_scalar;
+
+    switch (isa) {
+#ifdef SGM_X86_KERNELS
+    case SIMD_SSE41: return aggregate_sse41;
+    case SIMD_AVX2: return aggregate_avx2;
+    case SIMD_AVX512: return aggregate_avx512;
+#endif
+#ifdef SGM_NEON_KERNELS
+    case SIMD_NEON: return aggregate_neon;
+#endif
+    default: return aggregate_scalar;
+    }
+}
+
+HammingKernel hamming_kernel(SimdIsa isa)
+{
+    if (!simd_isa_supported(isa))
+        return hamming_scalar;
+
+    switch (isa) {
+#ifdef SGM_X86_KERNELS
+    case SIMD_SSE41: return hamming_sse41;
+    case SIMD_AVX2: return hamming_avx2;
+    case SIMD_AVX512: return hamming_avx512;
+#endif
+#ifdef SGM_NEON_KERNELS
+    case SIMD_NEON: return hamming_neon;
+#endif
+    default: return hamming_scalar;
+    }
+}
+
+IntervalKernel interval_kernel(SimdIsa isa)
+{
+    if (!simd_isa_supported(isa))
+        return interval_scalar;
+
+    switch (isa) {
+#ifdef SGM_X86_KERNELS
+    case SIMD_SSE41: return interval_sse41;
+    case SIMD_AVX2: return interval_avx2;
+    case SIMD_AVX512: return interval_avx512;
+#endif
+#ifdef SGM_NEON_KERNELS
+    case SIMD_NEON: return interval_neon;
+#endif
+    default: return interval_scalar;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef SGMKERNELS_H
+#define SGMKERNELS_H
+
+#include <stdint.h>
+
+// the inner loops of the semi-global matching engine (see sgmengine.h) and of its
+// matching costs (see sgmcosts.h), with one implementation per instruction set, selected
+// at runtime
+
+// the instruction sets, from the slowest to the fastest
+enum SimdIsa {
+    SIMD_SCALAR,
+    SIMD_SSE41,
+    SIMD_AVX2,
+    SIMD_AVX512,
+    SIMD_NEON
+};
+
+// the cost of one pixel along one aggregation path, for all the disparities:
+//     current[d] = cost[d] + min(previous[d], previous[d - 1] + P1, previous[d + 1] + P1,
+//                                previous_min + P2) - previous_min
+//     sum[d] += current[d]
+// in saturated 16 bits arithmetic; previous must have a guard element on each side
+// (previous[-1] and previous[count], set to 0xffff); count is a multiple of 16
+// we return the minimum of current, the previous_min of the next pixel on the path
+typedef uint16_t (*AggregateKernel)(const uint16_t *cost, const uint16_t *previous, uint16_t previous_min,
+                                    uint16_t *current, uint16_t *sum, int count, uint16_t P1, uint16_t P2);
+
+// the Hamming distances between the census bits of a pixel and the ones of count candidates,
+// added to costs when accumulate is set (for transforms of more than 32 bits, one call per
+// word); count is a multiple of 16
+typedef void (*HammingKernel)(uint32_t value, const uint32_t *candidates, uint8_t *costs, int count,
+                              bool accumulate);
+
+// the dissimilarity of Birchfield and Tomasi between a pixel and count candidates: each
+// intensity is compared with the interval of intensities around the other pixel (up to its
+// half neighbours), and the smallest distance is kept
+//     costs[d] = min(max(0, value - maximums[d], minimums[d] - value),
+//                    max(0, values[d] - maximum, minimum - values[d]))
+// with intervals of a single value, this is the absolute difference; count is a multiple of 16
+typedef void (*IntervalKernel)(uint8_t value, uint8_t minimum, uint8_t maximum,
+                               const uint8_t *values, const uint8_t *minimums, const uint8_t *maximums,
+                               uint8_t *costs, int count);
+
+// the fastest instruction set of this processor (among the ones this build has kernels for)
+SimdIsa best_simd_isa();
+bool simd_isa_supported(SimdIsa isa);
+const char *simd_isa_name(SimdIsa isa);
+
+// the kernel of an instruction set (which must be supported)
+AggregateKernel aggregate_kernel(SimdIsa isa);
+HammingKernel hamming_kernel(SimdIsa isa);
+IntervalKernel interval_kernel(SimdIsa isa);
+
+#endif // SGMKERNELS_H
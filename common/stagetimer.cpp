@@ -0,0 +1,124 @@
+#include "stagetimer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+StageTimer::Scope::Scope(StageTimer &timer, const char *stage) :
+    timer(&timer),
+    stage(stage),
+    start(std::chrono::steady_clock::now())
+{
+}
+
+StageTimer::Scope::Scope(StageTimer *timer, const char *stage) :
+    timer(timer),
+    stage(stage),
+    start(std::chrono::steady_clock::now())
+{
+}
+
+StageTimer::Scope::~Scope()
+{
+    if (timer)
+        timer->add(stage, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+StageTimer::StageTimer(size_t window) :
+    window(std::max<size_t>(1, window))
+{
+}
+
+void StageTimer::add(const std::string &stage, double ms)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, std::deque<double> >::iterator it = durations.find(stage);
+    if (it == durations.end()) {
+        stages.push_back(stage);
+        it = durations.insert(std::make_pair(stage, std::deque<double>())).first;
+    }
+
+    it->second.push_back(ms);
+    if (it->second.size() > window)
+        it->second.pop_front();
+}
+
+void StageTimer::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stages.clear();
+    durations.clear();
+}
+
+// the value below which the given fraction of the sorted values lie (nearest rank)
+static double percentile(const std::vector<double> &sorted, double fraction)
+{
+    size_t rank = size_t(fraction * sorted.size() + 0.5);
+    rank = std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0);
+    return sorted[rank];
+}
+
+std::vector<StageTimer::Statistics> StageTimer::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Statistics> result;
+    for (size_t i = 0; i < stages.size(); i++) {
+        const std::deque<double> &values = durations.find(stages[i])->second;
+        std::vector<double> sorted(values.begin(), values.end());
+        std::sort(sorted.begin(), sorted.end());
+
+        Statistics statistics;
+        statistics.stage = stages[i];
+        statistics.count = sorted.size();
+        statistics.last = values.back();
+        statistics.p50 = percentile(sorted, 0.50);
+        statistics.p95 = percentile(sorted, 0.95);
+        statistics.p99 = percentile(sorted, 0.99);
+        result.push_back(statistics);
+    }
+    return result;
+}
+
+std::string StageTimer::summary() const
+{
+    std::vector<Statistics> all = statistics();
+    std::string text;
+    char buffer[128];
+    for (size_t i = 0; i < all.size(); i++) {
+        std::snprintf(buffer, sizeof(buffer), "%s%s %.1f/%.1f ms", i > 0 ? "  " : "",
+                      all[i].stage.c_str(), all[i].p50, all[i].p95);
+        text += buffer;
+    }
+    return text;
+}
+
+bool StageTimer::export_csv(const std::string &filename) const
+{
+    std::ofstream file(filename.c_str());
+    if (!file)
+        return false;
+
+    std::vector<Statistics> all = statistics();
+    file << "stage,count,last_ms,p50_ms,p95_ms,p99_ms" << std::endl;
+    for (size_t i = 0; i < all.size(); i++)
+        file << all[i].stage << "," << all[i].count << "," << all[i].last << ","
+             << all[i].p50 << "," << all[i].p95 << "," << all[i].p99 << std::endl;
+    return bool(file);
+}
+
+bool StageTimer::export_json(const std::string &filename) const
+{
+    std::ofstream file(filename.c_str());
+    if (!file)
+        return false;
+
+    // the stage names are plain identifiers chosen in the code, so they need no escaping
+    std::vector<Statistics> all = statistics();
+    file << "{\n  \"stages\": [";
+    for (size_t i = 0; i < all.size(); i++)
+        file << (i > 0 ? "," : "") << "\n    {\"stage\": \"" << all[i].stage << "\", \"count\": " << all[i].count
+             << ", \"last_ms\": " << all[i].last << ", \"p50_ms\": " << all[i].p50
+             << ", \"p95_ms\": " << all[i].p95 << ", \"p99_ms\": " << all[i].p99 << "}";
+    file << "\n  ]\n}" << std::endl;
+    return bool(file);
+}
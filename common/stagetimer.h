@@ -0,0 +1,65 @@
+#ifndef STAGETIMER_H
+#define STAGETIMER_H
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// collects how long each stage of the depth map computation takes
+// (image decoding, matching, conversion for display...), keeping the last
+// durations of each stage to compute rolling percentiles
+// the stages can be timed from any thread
+class StageTimer
+{
+public:
+    // the percentiles of the last durations of a stage, in ms
+    struct Statistics {
+        std::string stage;
+        size_t count;  // number of durations in the window
+        double last;
+        double p50;
+        double p95;
+        double p99;
+    };
+
+    // times a stage from its creation to its destruction:
+    //     { StageTimer::Scope scope(timer, "match"); matcher->compute(...); }
+    class Scope
+    {
+    public:
+        Scope(StageTimer &timer, const char *stage);
+        Scope(StageTimer *timer, const char *stage);  // does nothing without a timer
+        ~Scope();
+
+    private:
+        StageTimer *timer;
+        const char *stage;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // the percentiles are computed over the last window durations of each stage
+    explicit StageTimer(size_t window = 200);
+
+    void add(const std::string &stage, double ms);
+    void clear();
+
+    // the stages are in the order they were first timed
+    std::vector<Statistics> statistics() const;
+
+    // a single line, with the median and the 95th percentile of each stage
+    std::string summary() const;
+
+    bool export_csv(const std::string &filename) const;
+    bool export_json(const std::string &filename) const;
+
+private:
+    mutable std::mutex mutex;
+    size_t window;
+    std::vector<std::string> stages;
+    std::map<std::string, std::deque<double> > durations;
+};
+
+#endif // STAGETIMER_H
@@ -0,0 +1,73 @@
+#include "stereomatch.h"
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include <algorithm>
+
+#include "sgmengine.h"
+
+void compute_disparity(const SGBMParams &params, const cv::Mat &left, const cv::Mat &right,
+                       cv::Mat &disparity)
+{
+    SGBMParams raw_params = params.raw_matching();
+    cv::Mat raw_disparity, buffer;
+    if (raw_params.engine == SGBMParams::ENGINE_SGM) {
+        SGMEngine engine;
+        engine.compute(raw_params, left, right, raw_disparity);
+    } else {
+        raw_params.create_matcher()->compute(left, right, raw_disparity);
+    }
+    post_process(params, raw_disparity, disparity, buffer);
+}
+
+void compute_filtered_disparity(const SGBMParams &params, const cv::Mat &left, const cv::Mat &right,
+                                cv::Mat &disparity)
+{
+    cv::Mat left_disparity, right_disparity;
+    compute_disparity(params, left, right, left_disparity);
+    compute_disparity(params.right_view(), right, left, right_disparity);
+
+    cv::Ptr<cv::ximgproc::DisparityWLSFilter> wls_filter =
+            cv::ximgproc::createDisparityWLSFilter(params.create_matcher());
+    params.apply_to(wls_filter);
+    wls_filter->filter(left_disparity, left, disparity, right_disparity);
+}
+
+size_t estimate_matching_memory(const SGBMParams &params, const cv::Size &size,
+                                size_t memory_limit, size_t cost_volume_budget)
+{
+    if (params.engine == SGBMParams::ENGINE_SGM)
+        return SGMEngine::estimate_memory(size, params, memory_limit, cost_volume_budget).peak_bytes;
+
+    // the buffer allocated by computeDisparitySGBM() of OpenCV 3, in 16 bits costs: the
+    // costs of the 8 paths of the current and previous rows (minLr and Lr), the block sums
+    // of the rows of the block (hsumBuf), then the pixel costs and the aggregated costs (C
+    // and S) of one row, or of the whole image with MODE_HH; MODE_SGBM_3WAY splits the
+    // image in stripes with buffers of about the same size in total
+    const size_t W = std::max(0, size.width), H = std::max(0, size.height);
+    const size_t D = std::max(0, params.num_disparities);
+    const int min_x = std::max(params.min_disparity + params.num_disparities, 0);
+    const int max_x = size.width + std::min(params.min_disparity, 0);
+    const size_t width1 = std::max(0, max_x - min_x);
+    const size_t paths = 8, padded_disparities = D + 16, directions = 2;
+    const size_t block_rows = (params.block_size / 2) * 2 + 2;
+    const size_t cost_rows = params.mode == cv::StereoSGBM::MODE_HH ? H : 1;
+
+    size_t bytes = ((width1 + 2) * paths * padded_disparities + (width1 + 2) * paths) * directions * sizeof(short) +
+                   width1 * D * (block_rows + 1) * sizeof(short) +
+                   width1 * D * cost_rows * 2 * sizeof(short) +
+                   W * 16 + W * 2 * sizeof(short) + 1024;
+    if (params.speckle_window_size > 0)
+        bytes += W * H * 9;  // the buffer of cv::filterSpeckles
+    return bytes;
+}
+
+void post_process(const SGBMParams &params, const cv::Mat &raw_disparity, cv::Mat &disparity, cv::Mat &buffer)
+{
+    raw_disparity.copyTo(disparity);
+
+    // the same call as in cv::StereoSGBM::compute()
+    if (params.speckle_window_size > 0)
+        cv::filterSpeckles(disparity, (params.min_disparity - 1) * cv::StereoMatcher::DISP_SCALE,
+                           params.speckle_window_size, cv::StereoMatcher::DISP_SCALE * params.speckle_range, buffer);
+}
@@ -0,0 +1,37 @@
+#ifndef STEREOMATCH_H
+#define STEREOMATCH_H
+
+#include "opencv2/core/core.hpp"
+
+#include "sgbmparams.h"
+
+// the depth map computation of the tuner, in one call, for the tools that process
+// many pairs without a GUI (each call creates its own matchers, so several threads
+// can compute disparity maps at the same time)
+
+// the raw semi-global block-matching disparity (CV_16SC1, in 1/16 of pixel), computed
+// by the engine of the parameters: the matcher runs with params.raw_matching(), then
+// post_process() filters the speckles, like in the tuner, so that both give the same maps
+void compute_disparity(const SGBMParams &params, const cv::Mat &left, const cv::Mat &right,
+                       cv::Mat &disparity);
+
+// the same disparity, post-processed with the wls-filter
+void compute_filtered_disparity(const SGBMParams &params, const cv::Mat &left, const cv::Mat &right,
+                                cv::Mat &disparity);
+
+// the memory used to match one view of images of this size, in bytes: the buffers of the
+// matcher (see SGMEngine::estimate_memory() for the SGM engine, the ones of
+// cv::StereoSGBM::compute() otherwise) and the one of the speckle filter, not the images
+// nor the disparity map
+// the memory limit and the cost volume budget are the ones of the SGM engine, the matchers
+// of OpenCV can not be bounded (with MODE_HH, they aggregate the whole image at once)
+size_t estimate_matching_memory(const SGBMParams &params, const cv::Size &size,
+                                size_t memory_limit, size_t cost_volume_budget);
+
+// the post-processing of the matcher, applied to a raw disparity computed with
+// params.raw_matching(), so that tuning the speckle filter does not match the images again:
+// the same call to cv::filterSpeckles() as the one of cv::StereoSGBM::compute()
+// buffer is the memory of the speckle filter, kept between calls
+void post_process(const SGBMParams &params, const cv::Mat &raw_disparity, cv::Mat &disparity, cv::Mat &buffer);
+
+#endif // STEREOMATCH_H
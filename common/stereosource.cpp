@@ -0,0 +1,93 @@
+#include "stereosource.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+StereoSource::StereoSource() :
+    raw_frame(0)
+{
+}
+
+bool StereoSource::open(const std::string &left, const std::string &right)
+{
+    close();
+    if (RawStereoFile::is_raw_stereo(left))
+        return raw_capture.open(left);
+
+    if (!left_capture.open(sequence_pattern(left)) || !right_capture.open(sequence_pattern(right))) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void StereoSource::close()
+{
+    left_capture.release();
+    right_capture.release();
+    raw_capture.close();
+    raw_frame = 0;
+}
+
+bool StereoSource::is_open() const
+{
+    return raw_capture.is_open() || (left_capture.isOpened() && right_capture.isOpened());
+}
+
+bool StereoSource::read(cv::Mat &left, cv::Mat &right)
+{
+    if (raw_capture.is_open())
+        return raw_capture.frame(raw_frame++, left, right);
+
+    if (!left_capture.grab() || !right_capture.grab())
+        return false;
+    return left_capture.retrieve(left) && right_capture.retrieve(right) && !left.empty() && !right.empty();
+}
+
+double StereoSource::frame_rate() const
+{
+    if (raw_capture.is_open())
+        return raw_capture.frame_rate();
+
+    // get() is not const in OpenCV 3
+    double fps = const_cast<cv::VideoCapture &>(left_capture).get(cv::CAP_PROP_FPS);
+    return fps > 0 && fps < 1000 ? fps : 0;
+}
+
+std::string StereoSource::sequence_pattern(const std::string &filename)
+{
+    static const char *image_extensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".pgm", ".ppm" };
+
+    size_t dot = filename.find_last_of('.');
+    size_t slash = filename.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return filename;
+
+    std::string extension = filename.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    bool is_image = false;
+    for (size_t i = 0; i < sizeof(image_extensions) / sizeof(image_extensions[0]); i++)
+        is_image = is_image || extension == image_extensions[i];
+    if (!is_image)
+        return filename;
+
+    // the last number of the file name (not of the directories)
+    size_t end = dot;
+    size_t name_start = slash == std::string::npos ? 0 : slash + 1;
+    while (end > name_start && !std::isdigit((unsigned char)filename[end - 1]))
+        end--;
+    size_t start = end;
+    while (start > name_start && std::isdigit((unsigned char)filename[start - 1]))
+        start--;
+    if (start == end)
+        return filename;
+
+    // a literal % in the name would be taken as a format by OpenCV
+    if (filename.find('%') != std::string::npos)
+        return filename;
+
+    char format[16];
+    std::snprintf(format, sizeof(format), "%%0%dd", int(end - start));
+    return filename.substr(0, start) + format + filename.substr(end);
+}
@@ -0,0 +1,44 @@
+#ifndef STEREOSOURCE_H
+#define STEREOSOURCE_H
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/videoio/videoio.hpp"
+
+#include <string>
+
+#include "rawstereo.h"
+
+// synchronized left and right frames, read from two video files, from two numbered
+// image sequences (left_0000.png, left_0001.png...), or from a raw stereo capture
+// (see RawStereoFile), whose frames are mapped in memory instead of being decoded
+class StereoSource
+{
+public:
+    StereoSource();
+
+    // for an image sequence, any file of the sequence can be given: the number in its
+    // name is replaced by a pattern, and the sequence is read from its first image
+    // a raw capture holds both views: it is given as left, and right is ignored
+    bool open(const std::string &left, const std::string &right);
+    void close();
+    bool is_open() const;
+
+    // we read the next pair (false at the end of either stream)
+    // both frames are grabbed before being decoded, so that they are as close in time as possible
+    // the frames of a raw capture point into the mapping (they keep it mapped, see RawStereoFile::frame())
+    bool read(cv::Mat &left, cv::Mat &right);
+
+    // the frame rate of the left video or of the capture, 0 if unknown (image sequences)
+    double frame_rate() const;
+
+    // "left_0042.png" -> "left_%04d.png"; the name itself if it is not an image or has no number
+    static std::string sequence_pattern(const std::string &filename);
+
+private:
+    cv::VideoCapture left_capture;
+    cv::VideoCapture right_capture;
+    RawStereoFile raw_capture;
+    int raw_frame;  // the next frame of the raw capture
+};
+
+#endif // STEREOSOURCE_H
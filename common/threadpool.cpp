@@ -0,0 +1,86 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+
+ThreadPool::ThreadPool(int thread_count) :
+    stopping(false)
+{
+    if (thread_count <= 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 0; i < thread_count; i++)
+        threads.push_back(std::thread(&ThreadPool::run, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+void ThreadPool::run()
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (tasks.empty() && !stopping)
+                condition.wait(lock);
+            if (tasks.empty())
+                return;
+            task = tasks.front();
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallel_for(int count, const std::function<void(int)> &task)
+{
+    if (count <= 0)
+        return;
+
+    // the state shared by the tasks of this call
+    struct Batch {
+        std::mutex mutex;
+        std::condition_variable done;
+        int remaining;
+        std::exception_ptr error;
+    };
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->remaining = count;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < count; i++) {
+            tasks.push_back([batch, &task, i]() {
+                std::exception_ptr error;
+                try {
+                    task(i);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                if (error && !batch->error)
+                    batch->error = error;
+                if (--batch->remaining == 0)
+                    batch->done.notify_all();
+            });
+        }
+    }
+    condition.notify_all();
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    while (batch->remaining > 0)
+        batch->done.wait(lock);
+    if (batch->error)
+        std::rethrow_exception(batch->error);
+}
@@ -0,0 +1,42 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a fixed set of threads running the tasks of parallel_for()
+//
+// several threads may call parallel_for() at the same time (their tasks are
+// interleaved in the queue), but a task must not call parallel_for() itself,
+// since it would wait for tasks that no thread is left to run
+class ThreadPool
+{
+public:
+    // 0 threads means one per core
+    explicit ThreadPool(int thread_count = 0);
+    ~ThreadPool();
+
+    int size() const { return int(threads.size()); }
+
+    // we run task(i) for all i in [0, count), and wait for all of them to finish
+    // the first exception thrown by a task is thrown again here
+    void parallel_for(int count, const std::function<void(int)> &task);
+
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()> > tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+
+    void run();
+
+    ThreadPool(const ThreadPool &);
+    ThreadPool &operator=(const ThreadPool &);
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,94 @@
+#include "tiledmatcher.h"
+
+#include <algorithm>
+
+TiledMatcher::TiledMatcher() :
+    strips(0),
+    overlap(-1),
+    cost_volume_budget(size_t(SGMEngine::DEFAULT_COST_VOLUME_BUDGET_MB) << 20),
+    memory_limit(0)
+{
+}
+
+void TiledMatcher::set_strips(int count)
+{
+    strips = std::max(0, count);
+}
+
+void TiledMatcher::set_overlap(int rows)
+{
+    overlap = rows;
+}
+
+void TiledMatcher::set_cost_volume_budget(size_t bytes)
+{
+    cost_volume_budget = bytes;
+}
+
+void TiledMatcher::set_memory_limit(size_t bytes)
+{
+    memory_limit = bytes;
+}
+
+int TiledMatcher::default_overlap(const SGBMParams &params)
+{
+    // beyond a few dozens of rows, the penalties P1 and P2 make the contribution of the
+    // vertical paths negligible
+    const int aggregation_margin = 32;
+    return params.block_size / 2 + aggregation_margin;
+}
+
+void TiledMatcher::compute(const SGBMParams &params, const cv::Mat &left, const cv::Mat &right,
+                           cv::Mat &disparity, ThreadPool &pool)
+{
+    int rows = left.rows;
+    int count = strips > 0 ? strips : pool.size();
+    int margin = overlap >= 0 ? overlap : default_overlap(params);
+
+    // a strip thinner than its overlap would be mostly recomputation
+    count = std::max(1, std::min(count, rows / std::max(1, margin)));
+
+    if ((int)matchers.size() != count) {
+        matchers.resize(count);
+        engines.resize(count);
+        strip_disparities.resize(count);
+    }
+    disparity.create(left.size(), CV_16SC1);
+
+    pool.parallel_for(count, [&](int i) {
+        // the central rows of the strip, and the rows actually matched
+        int first = rows * i / count;
+        int last = rows * (i + 1) / count;
+        int top = std::max(0, first - margin);
+        int bottom = std::min(rows, last + margin);
+
+        if (params.engine == SGBMParams::ENGINE_SGM) {
+            engines[i].set_cost_volume_budget(cost_volume_budget / count);
+            engines[i].set_memory_limit(memory_limit / count);
+            engines[i].compute(params, left.rowRange(top, bottom), right.rowRange(top, bottom), strip_disparities[i]);
+        } else {
+            if (matchers[i].empty())
+                matchers[i] = params.create_matcher();
+            else
+                params.apply_to(matchers[i]);
+
+            matchers[i]->compute(left.rowRange(top, bottom), right.rowRange(top, bottom), strip_disparities[i]);
+        }
+        strip_disparities[i].rowRange(first - top, last - top).copyTo(disparity.rowRange(first, last));
+    });
+}
+
+TiledMatcher::Validation TiledMatcher::compare(const cv::Mat &tiled, const cv::Mat &reference)
+{
+    cv::Mat difference;
+    cv::absdiff(tiled, reference, difference);
+
+    double max_difference;
+    cv::minMaxLoc(difference, 0, &max_difference);
+
+    Validation validation;
+    validation.differing_pixels = cv::countNonZero(difference);
+    validation.max_difference = int(max_difference);
+    validation.differing_ratio = double(validation.differing_pixels) / std::max(1, int(tiled.total()));
+    return validation;
+}
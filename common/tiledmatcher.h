@@ -0,0 +1,70 @@
+#ifndef TILEDMATCHER_H
+#define TILEDMATCHER_H
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include <vector>
+
+#include "sgbmparams.h"
+#include "sgmengine.h"
+#include "threadpool.h"
+
+// computes a semi-global block-matching disparity map strip by strip, in parallel
+//
+// the images are split into horizontal strips, each strip is extended by some rows
+// of overlap above and below, matched on its own thread with its own matcher,
+// and only its central rows are copied back into the disparity map
+// the overlap hides the seams: it must cover half the block, plus enough rows for
+// the vertical aggregation paths of SGBM to converge, so the result is close to,
+// but not exactly, the one of a single cv::StereoSGBM::compute() on the whole images
+class TiledMatcher
+{
+public:
+    // the difference between a tiled map and the map computed in one piece
+    struct Validation {
+        int differing_pixels;
+        int max_difference;  // in 1/16 of pixel, like the disparity maps
+        double differing_ratio;
+    };
+
+    TiledMatcher();
+
+    // 0 strips: one per thread of the pool
+    void set_strips(int count);
+
+    // the overlap in rows, -1 to derive it from the parameters (see default_overlap())
+    void set_overlap(int rows);
+
+    // the memory the cost volumes of the SGM engine may use, shared by the strips
+    // (see SGMEngine::set_cost_volume_budget())
+    void set_cost_volume_budget(size_t bytes);
+
+    // the memory the SGM engines may use, shared by the strips (0 for no limit; see
+    // SGMEngine::set_memory_limit())
+    void set_memory_limit(size_t bytes);
+
+    // we compute the disparity of left with respect to right (the arguments are
+    // the same as the ones of cv::StereoMatcher::compute(), plus the parameters)
+    void compute(const SGBMParams &params, const cv::Mat &left, const cv::Mat &right,
+                 cv::Mat &disparity, ThreadPool &pool);
+
+    // half the block size, and a margin for the aggregation along vertical paths
+    static int default_overlap(const SGBMParams &params);
+
+    // we compare a tiled map with the one computed in one piece
+    static Validation compare(const cv::Mat &tiled, const cv::Mat &reference);
+
+private:
+    int strips;
+    int overlap;
+    size_t cost_volume_budget;
+    size_t memory_limit;
+
+    // one matcher (or engine, see SGBMParams::engine) and one output buffer per strip,
+    // kept between two calls
+    std::vector<cv::Ptr<cv::StereoSGBM> > matchers;
+    std::vector<SGMEngine> engines;
+    std::vector<cv::Mat> strip_disparities;
+};
+
+#endif // TILEDMATCHER_H